@@ -17,6 +17,12 @@ set(CONFIG_CONTENT
 check_cxx_symbol_exists(execvpe unistd.h PTL_HAVE_EXECVPE)
 string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_EXECVPE\n")
 
+check_cxx_symbol_exists(__NR_pidfd_open sys/syscall.h PTL_HAVE_PIDFD)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_PIDFD\n")
+
+check_cxx_symbol_exists(vfork unistd.h PTL_HAVE_VFORK)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_VFORK\n")
+
 check_cxx_symbol_exists(posix_spawn_file_actions_addinherit_np spawn.h PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDINHERIT_NP)
 string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDINHERIT_NP\n")
 
@@ -99,6 +105,26 @@ check_cxx_source_compiles("
 PTL_HAVE_IP_MREQ)
 string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_IP_MREQ\n")
 
+check_cxx_source_compiles("
+    #include <sys/types.h>
+    #include <sys/socket.h>
+
+    int main() {
+        struct sockaddr addr;
+        addr.sa_len = sizeof(addr);
+    }"
+PTL_HAVE_SOCKADDR_SA_LEN)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_SOCKADDR_SA_LEN\n")
+
+check_cxx_symbol_exists(accept4 sys/socket.h PTL_HAVE_ACCEPT4)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_ACCEPT4\n")
+
+check_cxx_symbol_exists(recvmmsg sys/socket.h PTL_HAVE_RECVMMSG)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_RECVMMSG\n")
+
+check_cxx_symbol_exists(sendmmsg sys/socket.h PTL_HAVE_SENDMMSG)
+string(APPEND CONFIG_CONTENT "#cmakedefine01 PTL_HAVE_SENDMMSG\n")
+
 check_cxx_source_compiles("
     #include <sys/types.h>
     #include <unistd.h>
@@ -0,0 +1,472 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef PTL_HEADER_ASYNC_H_INCLUDED
+#define PTL_HEADER_ASYNC_H_INCLUDED
+
+#include <ptl/core.h>
+#include <ptl/file.h>
+#include <ptl/socket.h>
+
+#if __has_include(<sys/epoll.h>)
+    #include <sys/epoll.h>
+#endif
+
+#include <coroutine>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <tuple>
+#include <cassert>
+
+#if defined(EPOLLIN) && defined(MSG_DONTWAIT)
+
+namespace ptl::inline v0 {
+
+    class EventLoop;
+    class Cancellation;
+
+    namespace impl {
+        struct AsyncWaiter {
+            enum State { Idle, Waiting, Ready };
+
+            EventLoop * loop = nullptr;
+            std::coroutine_handle<> handle;
+            //retries the operation, returns false if it would still block
+            auto (*attempt)(AsyncWaiter &) noexcept -> bool = nullptr;
+            int fd = -1;
+            uint32_t events = 0;
+            //set if the wait rather than the operation failed: ETIMEDOUT, ECANCELED or an epoll error
+            int waitError = 0;
+            State state = Idle;
+            bool hasTimer = false;
+            std::multimap<std::chrono::steady_clock::time_point, AsyncWaiter *>::iterator timer;
+            Cancellation * cancellation = nullptr;
+        };
+
+        template<class Call>
+        inline auto attemptNonBlocking(Call call, io_ssize_t & result, int & error) noexcept -> bool {
+            for ( ; ; ) {
+                result = call();
+                if (result >= 0) {
+                    error = 0;
+                    return true;
+                }
+                error = errno;
+                if (error != EINTR)
+                    return error != EAGAIN && error != EWOULDBLOCK;
+            }
+        }
+    }
+
+    //Cancels every operation it is passed to via AwaitOptions.
+    //Not thread safe: cancel() must be called on the thread running the event loop.
+    class Cancellation {
+        friend EventLoop;
+    public:
+        Cancellation() noexcept = default;
+        Cancellation(const Cancellation &) = delete;
+        Cancellation & operator=(const Cancellation &) = delete;
+        ~Cancellation() noexcept
+            { assert(m_waiters.empty()); }
+
+        //suspended operations complete with ECANCELED on the next loop iteration,
+        //operations started afterwards fail with ECANCELED immediately
+        void cancel();
+
+        auto cancelled() const noexcept -> bool
+            { return m_cancelled; }
+        void reset() noexcept
+            { m_cancelled = false; }
+    private:
+        std::vector<impl::AsyncWaiter *> m_waiters;
+        bool m_cancelled = false;
+    };
+
+    struct AwaitOptions {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        Cancellation * cancellation = nullptr;
+
+        static auto timeout(std::chrono::steady_clock::duration duration, Cancellation * cancellation = nullptr) -> AwaitOptions
+            { return {std::chrono::steady_clock::now() + duration, cancellation}; }
+    };
+
+    //Single-threaded readiness loop resuming coroutines suspended in asyncXXX operations.
+    //Must not be moved or destroyed while operations are pending.
+    class EventLoop {
+        friend Cancellation;
+        template<class Op, class... Err> friend class AsyncOperation;
+    public:
+        EventLoop() noexcept = default;
+
+        static auto create(PTL_ERROR_REF_ARG(err)) -> EventLoop
+        requires(PTL_ERROR_REQ(err)) {
+            EventLoop ret;
+            ret.m_epoll = FileDescriptor(::epoll_create1(EPOLL_CLOEXEC));
+            if (!ret.m_epoll)
+                handleError(PTL_ERROR_REF(err), errno, "epoll_create1() failed");
+            else
+                clearError(PTL_ERROR_REF(err));
+            return ret;
+        }
+
+        //number of suspended operations
+        auto pending() const noexcept -> size_t
+            { return m_pending; }
+
+        auto epoll() const noexcept -> const FileDescriptor &
+            { return m_epoll; }
+
+        explicit operator bool() const noexcept
+            { return bool(m_epoll); }
+
+        //Waits for at most timeout (indefinitely if negative) and resumes every coroutine whose operation
+        //completed, timed out or was cancelled. Returns the number of coroutines resumed.
+        auto runOnce(std::chrono::milliseconds timeout,
+                     PTL_ERROR_REF_ARG(err)) -> size_t
+        requires(PTL_ERROR_REQ(err)) {
+            using namespace std::chrono;
+
+            if (!m_ready.empty())
+                timeout = milliseconds(0);
+            if (!m_timers.empty()) {
+                auto untilDeadline = ceil<milliseconds>(m_timers.begin()->first - steady_clock::now());
+                untilDeadline = std::max(untilDeadline, milliseconds(0));
+                if (timeout < milliseconds(0) || untilDeadline < timeout)
+                    timeout = untilDeadline;
+            }
+            if (timeout > milliseconds(std::numeric_limits<int>::max()))
+                timeout = milliseconds(std::numeric_limits<int>::max());
+
+            epoll_event events[64];
+            int count = ::epoll_wait(m_epoll.get(), events, int(std::size(events)), int(timeout.count()));
+            if (count < 0) {
+                if (errno != EINTR) {
+                    handleError(PTL_ERROR_REF(err), errno, "epoll_wait({}) failed", m_epoll.get());
+                    return 0;
+                }
+                count = 0;
+            }
+            for (int i = 0; i < count; ++i) {
+                auto it = m_registrations.find(events[i].data.fd);
+                if (it == m_registrations.end())
+                    continue;
+                //errors and hangups wake both directions so that the retried call reports them
+                auto revents = events[i].events;
+                auto reader = (revents & (EPOLLIN | EPOLLERR | EPOLLHUP)) ? it->second.reader : nullptr;
+                auto writer = (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ? it->second.writer : nullptr;
+                //completion may erase the registration so `it` is not used below
+                for (auto waiter: {reader, writer}) {
+                    if (waiter && waiter->attempt(*waiter))
+                        complete(*waiter, 0);
+                }
+            }
+            auto now = steady_clock::now();
+            while (!m_timers.empty() && m_timers.begin()->first <= now)
+                complete(*m_timers.begin()->second, ETIMEDOUT);
+
+            size_t resumed = 0;
+            while (!m_ready.empty()) {
+                auto waiter = m_ready.front();
+                m_ready.pop_front();
+                waiter->state = impl::AsyncWaiter::Idle;
+                --m_pending;
+                ++resumed;
+                waiter->handle.resume();
+            }
+            clearError(PTL_ERROR_REF(err));
+            return resumed;
+        }
+
+        //runs until no operations are pending
+        void run(PTL_ERROR_REF_ARG(err))
+        requires(PTL_ERROR_REQ(err)) {
+            while (m_pending) {
+                runOnce(std::chrono::milliseconds(-1), PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return;
+            }
+            clearError(PTL_ERROR_REF(err));
+        }
+    private:
+        struct Registration {
+            impl::AsyncWaiter * reader = nullptr;
+            impl::AsyncWaiter * writer = nullptr;
+        };
+
+        auto startWait(impl::AsyncWaiter & waiter, const AwaitOptions & options) -> int {
+            auto [it, added] = m_registrations.try_emplace(waiter.fd);
+            auto & reg = it->second;
+            auto & slot = (waiter.events & EPOLLIN) ? reg.reader : reg.writer;
+            if (slot)
+                return EBUSY;
+            slot = &waiter;
+            if (int res = updateRegistration(waiter.fd, reg, !added)) {
+                slot = nullptr;
+                if (added)
+                    m_registrations.erase(it);
+                return res;
+            }
+            if (options.deadline != std::chrono::steady_clock::time_point::max()) {
+                waiter.timer = m_timers.emplace(options.deadline, &waiter);
+                waiter.hasTimer = true;
+            }
+            if (options.cancellation) {
+                options.cancellation->m_waiters.push_back(&waiter);
+                waiter.cancellation = options.cancellation;
+            }
+            waiter.loop = this;
+            waiter.state = impl::AsyncWaiter::Waiting;
+            ++m_pending;
+            return 0;
+        }
+
+        auto updateRegistration(int fd, const Registration & reg, bool existing) noexcept -> int {
+            epoll_event ev{};
+            ev.events = (reg.reader ? uint32_t(EPOLLIN) : 0) | (reg.writer ? uint32_t(EPOLLOUT) : 0);
+            ev.data.fd = fd;
+            int res;
+            if (!ev.events)
+                res = ::epoll_ctl(m_epoll.get(), EPOLL_CTL_DEL, fd, &ev);
+            else
+                res = ::epoll_ctl(m_epoll.get(), existing ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+            return res == 0 ? 0 : errno;
+        }
+
+        void detach(impl::AsyncWaiter & waiter) noexcept {
+            if (auto it = m_registrations.find(waiter.fd); it != m_registrations.end()) {
+                auto & reg = it->second;
+                if (reg.reader == &waiter)
+                    reg.reader = nullptr;
+                if (reg.writer == &waiter)
+                    reg.writer = nullptr;
+                //failure here means the descriptor is already closed which removed it from epoll anyway
+                updateRegistration(waiter.fd, reg, true);
+                if (!reg.reader && !reg.writer)
+                    m_registrations.erase(it);
+            }
+            if (waiter.hasTimer) {
+                m_timers.erase(waiter.timer);
+                waiter.hasTimer = false;
+            }
+            if (waiter.cancellation) {
+                auto & waiters = waiter.cancellation->m_waiters;
+                waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+                waiter.cancellation = nullptr;
+            }
+        }
+
+        void complete(impl::AsyncWaiter & waiter, int waitError) {
+            detach(waiter);
+            waiter.waitError = waitError;
+            waiter.state = impl::AsyncWaiter::Ready;
+            m_ready.push_back(&waiter);
+        }
+
+        //the operation is being destroyed together with its suspended coroutine
+        void abandon(impl::AsyncWaiter & waiter) noexcept {
+            if (waiter.state == impl::AsyncWaiter::Waiting)
+                detach(waiter);
+            else if (waiter.state == impl::AsyncWaiter::Ready)
+                m_ready.erase(std::find(m_ready.begin(), m_ready.end(), &waiter));
+            else
+                return;
+            waiter.state = impl::AsyncWaiter::Idle;
+            --m_pending;
+        }
+    private:
+        FileDescriptor m_epoll;
+        std::unordered_map<int, Registration> m_registrations;
+        std::multimap<std::chrono::steady_clock::time_point, impl::AsyncWaiter *> m_timers;
+        std::deque<impl::AsyncWaiter *> m_ready;
+        size_t m_pending = 0;
+    };
+
+    inline void Cancellation::cancel() {
+        m_cancelled = true;
+        while (!m_waiters.empty()) {
+            auto waiter = m_waiters.back();
+            waiter->loop->complete(*waiter, ECANCELED);
+        }
+    }
+
+    //Awaitable returned by asyncXXX functions. The operation is attempted immediately and
+    //the coroutine is only suspended if it would block.
+    template<class Op, class... Err>
+    class [[nodiscard]] AsyncOperation : private impl::AsyncWaiter {
+    public:
+        AsyncOperation(EventLoop & loop, const Op & op, const AwaitOptions & options, Err & ...err) :
+            m_loop(loop),
+            m_op(op),
+            m_options(options),
+            m_err(err...) {
+
+            this->fd = op.fd;
+            this->events = Op::events;
+            this->attempt = [](impl::AsyncWaiter & waiter) noexcept {
+                return static_cast<AsyncOperation &>(waiter).m_op.attempt();
+            };
+        }
+        AsyncOperation(const AsyncOperation &) = delete;
+        AsyncOperation & operator=(const AsyncOperation &) = delete;
+        ~AsyncOperation() noexcept
+            { m_loop.abandon(*this); }
+
+        auto await_ready() noexcept -> bool {
+            if (m_options.cancellation && m_options.cancellation->cancelled()) {
+                this->waitError = ECANCELED;
+                return true;
+            }
+            return m_op.attempt();
+        }
+
+        auto await_suspend(std::coroutine_handle<> handle) -> bool {
+            this->handle = handle;
+            if (std::chrono::steady_clock::now() >= m_options.deadline)
+                this->waitError = ETIMEDOUT;
+            else
+                this->waitError = m_loop.startWait(*this, m_options);
+            return this->waitError == 0;
+        }
+
+        auto await_resume() -> io_ssize_t {
+            int code = this->waitError ? this->waitError : m_op.error;
+            std::apply([&](Err & ...err) {
+                if (code)
+                    handleError(PTL_ERROR_REF(err), code, Op::format, m_op.fd, m_op.size);
+                else
+                    clearError(PTL_ERROR_REF(err));
+            }, m_err);
+            return this->waitError ? -1 : m_op.result;
+        }
+    private:
+        EventLoop & m_loop;
+        Op m_op;
+        AwaitOptions m_options;
+        std::tuple<Err &...> m_err;
+    };
+
+    namespace impl {
+        struct AsyncReceiveOp {
+            static constexpr uint32_t events = EPOLLIN;
+            static constexpr const char * format = "recv({}, ,{}) failed";
+
+            int fd;
+            void * buf;
+            io_size_t size;
+            int flags;
+            io_ssize_t result = -1;
+            int error = 0;
+
+            auto attempt() noexcept -> bool
+                { return attemptNonBlocking([this]() { return ::recv(fd, buf, size, flags | MSG_DONTWAIT); }, result, error); }
+        };
+
+        struct AsyncSendOp {
+            static constexpr uint32_t events = EPOLLOUT;
+            static constexpr const char * format = "send({}, ,{}) failed";
+
+            int fd;
+            const void * buf;
+            io_size_t size;
+            int flags;
+            io_ssize_t result = -1;
+            int error = 0;
+
+            auto attempt() noexcept -> bool
+                { return attemptNonBlocking([this]() { return ::send(fd, buf, size, flags | MSG_DONTWAIT); }, result, error); }
+        };
+
+        struct AsyncReadOp {
+            static constexpr uint32_t events = EPOLLIN;
+            static constexpr const char * format = "read({}, ,{}) failed";
+
+            int fd;
+            void * buf;
+            io_size_t size;
+            io_ssize_t result = -1;
+            int error = 0;
+
+            auto attempt() noexcept -> bool
+                { return attemptNonBlocking([this]() { return ::read(fd, buf, size); }, result, error); }
+        };
+
+        struct AsyncWriteOp {
+            static constexpr uint32_t events = EPOLLOUT;
+            static constexpr const char * format = "write({}, ,{}) failed";
+
+            int fd;
+            const void * buf;
+            io_size_t size;
+            io_ssize_t result = -1;
+            int error = 0;
+
+            auto attempt() noexcept -> bool
+                { return attemptNonBlocking([this]() { return ::write(fd, buf, size); }, result, error); }
+        };
+    }
+
+    inline auto asyncReceiveSocket(EventLoop & loop, SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                                   const AwaitOptions & options,
+                                   PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncReceiveOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        return {loop, impl::AsyncReceiveOp{fd, buf, length, flags}, options, PTL_ERROR_REF(err)};
+    }
+
+    inline auto asyncReceiveSocket(EventLoop & loop, SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                                   PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncReceiveOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        return asyncReceiveSocket(loop, std::forward<decltype(socket)>(socket), buf, length, flags, AwaitOptions{}, PTL_ERROR_REF(err));
+    }
+
+    inline auto asyncSendSocket(EventLoop & loop, SocketLike auto && socket, const void * buf, io_size_t length, int flags,
+                                const AwaitOptions & options,
+                                PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncSendOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        return {loop, impl::AsyncSendOp{fd, buf, length, flags}, options, PTL_ERROR_REF(err)};
+    }
+
+    inline auto asyncSendSocket(EventLoop & loop, SocketLike auto && socket, const void * buf, io_size_t length, int flags,
+                                PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncSendOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        return asyncSendSocket(loop, std::forward<decltype(socket)>(socket), buf, length, flags, AwaitOptions{}, PTL_ERROR_REF(err));
+    }
+
+    //desc must be in non-blocking mode unless it is a regular file
+    inline auto asyncReadFile(EventLoop & loop, FileDescriptorLike auto && desc, void * buf, io_size_t nbyte,
+                              const AwaitOptions & options,
+                              PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncReadOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        return {loop, impl::AsyncReadOp{fd, buf, nbyte}, options, PTL_ERROR_REF(err)};
+    }
+
+    inline auto asyncReadFile(EventLoop & loop, FileDescriptorLike auto && desc, void * buf, io_size_t nbyte,
+                              PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncReadOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        return asyncReadFile(loop, std::forward<decltype(desc)>(desc), buf, nbyte, AwaitOptions{}, PTL_ERROR_REF(err));
+    }
+
+    //desc must be in non-blocking mode unless it is a regular file
+    inline auto asyncWriteFile(EventLoop & loop, FileDescriptorLike auto && desc, const void * buf, io_size_t nbyte,
+                               const AwaitOptions & options,
+                               PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncWriteOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        return {loop, impl::AsyncWriteOp{fd, buf, nbyte}, options, PTL_ERROR_REF(err)};
+    }
+
+    inline auto asyncWriteFile(EventLoop & loop, FileDescriptorLike auto && desc, const void * buf, io_size_t nbyte,
+                               PTL_ERROR_REF_ARG(err)) -> AsyncOperation<impl::AsyncWriteOp, std::remove_reference_t<decltype(err)>...>
+    requires(PTL_ERROR_REQ(err)) {
+        return asyncWriteFile(loop, std::forward<decltype(desc)>(desc), buf, nbyte, AwaitOptions{}, PTL_ERROR_REF(err));
+    }
+}
+
+#endif
+
+#endif
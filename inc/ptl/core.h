@@ -371,7 +371,7 @@ namespace ptl::inline v0 {
 
     private:
         void transform(StringLikeArray auto && array, UnsignedIntegral auto size) {
-            using ArrayType = std::remove_cvref_t<decltype(array)>;
+            using ArrayType = decltype(array);
 
             m_transformed.reset(new const char *[size + 1]);
             if constexpr (std::is_convertible_v<decltype(*std::begin(std::forward<ArrayType>(array))), const char *>) {
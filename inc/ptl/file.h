@@ -12,6 +12,7 @@
     #include <io.h>
 #endif
 #include <fcntl.h>
+#include <stdio.h>
 #include <sys/stat.h>
 #if __has_include(<sys/file.h>)
     #include <sys/file.h>
@@ -19,6 +20,18 @@
 #if __has_include(<sys/mman.h>)
     #include <sys/mman.h>
 #endif
+#if __has_include(<sys/uio.h>)
+    #include <sys/uio.h>
+#endif
+#if __has_include(<poll.h>)
+    #include <poll.h>
+#endif
+
+#include <limits.h>
+
+#include <chrono>
+#include <optional>
+#include <span>
 
 namespace ptl::inline v0 {
 
@@ -126,6 +139,27 @@ namespace ptl::inline v0 {
         }
         #endif
 
+        #if defined(O_TMPFILE) && defined(AT_EMPTY_PATH)
+        static auto openAnonymousTemp(PathLike auto && dir, int oflag, mode_t mode, PTL_ERROR_REF_ARG(err)) -> FileDescriptor 
+        requires(PTL_ERROR_REQ(err)) {
+
+            auto cdir = c_path(std::forward<decltype(dir)>(dir));
+            auto fd = impl::open(cdir, oflag | O_TMPFILE, mode);
+            if (fd < 0) {
+                fd = -1;
+                handleError(PTL_ERROR_REF(err), errno, "cannot open anonymous temporary file in {}", cdir);
+            } else {
+                clearError(PTL_ERROR_REF(err));
+            }
+            return FileDescriptor(fd);
+        }
+
+        static auto openAnonymousTemp(PathLike auto && dir, int oflag, PTL_ERROR_REF_ARG(err)) -> FileDescriptor 
+        requires(PTL_ERROR_REQ(err)) {
+            return openAnonymousTemp(std::forward<decltype(dir)>(dir), oflag, S_IRUSR | S_IWUSR, PTL_ERROR_REF(err));
+        }
+        #endif
+
         friend void swap(FileDescriptor & lhs, FileDescriptor & rhs) noexcept {
             std::swap(lhs.m_fd, rhs.m_fd);
         }
@@ -183,6 +217,144 @@ namespace ptl::inline v0 {
         FileDescriptor writeEnd;
     };
 
+    #if defined(O_TMPFILE) && defined(AT_EMPTY_PATH)
+    inline void publishFile(FileDescriptorLike auto && desc, PathLike auto && path,
+                            PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        auto cpath = c_path(std::forward<decltype(path)>(path));
+        if (::linkat(fd, "", AT_FDCWD, cpath, AT_EMPTY_PATH) == 0) {
+            clearError(PTL_ERROR_REF(err));
+            return;
+        }
+        //AT_EMPTY_PATH requires CAP_DAC_READ_SEARCH, the /proc link does not
+        int code = errno;
+        if (code == ENOENT || code == EPERM) {
+            char procPath[32];
+            snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+            if (::linkat(AT_FDCWD, procPath, AT_FDCWD, cpath, AT_SYMLINK_FOLLOW) == 0) {
+                clearError(PTL_ERROR_REF(err));
+                return;
+            }
+            if (errno != ENOENT)
+                code = errno;
+        }
+        handleError(PTL_ERROR_REF(err), code, "linkat({}, {}) failed", fd, cpath);
+    }
+    #endif
+
+    #if (defined(O_TMPFILE) && defined(AT_EMPTY_PATH)) || PTL_HAVE_MKOSTEMPS
+    class PendingFile {
+    public:
+        PendingFile() noexcept = default;
+        ~PendingFile() noexcept {
+            if (!m_tempName.empty())
+                ::unlink(m_tempName.c_str());
+        }
+        PendingFile(PendingFile && src) noexcept :
+            m_fd(std::move(src.m_fd)),
+            m_tempName(std::move(src.m_tempName)) {
+            src.m_tempName.clear();
+        }
+        PendingFile(const PendingFile &) = delete;
+        PendingFile & operator=(PendingFile src) noexcept {
+            swap(src, *this);
+            return *this;
+        }
+
+        static auto create(PathLike auto && dir, int oflag, mode_t mode, PTL_ERROR_REF_ARG(err)) -> PendingFile 
+        requires(PTL_ERROR_REQ(err)) {
+            PendingFile ret;
+            auto cdir = c_path(std::forward<decltype(dir)>(dir));
+            #if defined(O_TMPFILE) && defined(AT_EMPTY_PATH)
+                auto fd = impl::open(cdir, oflag | O_TMPFILE, mode);
+                if (fd >= 0) {
+                    ret.m_fd = FileDescriptor(fd);
+                    clearError(PTL_ERROR_REF(err));
+                    return ret;
+                }
+                int code = errno;
+                //EOPNOTSUPP, EISDIR and EINVAL mean the filesystem or kernel does not support O_TMPFILE
+                if (!PTL_HAVE_MKOSTEMPS || (code != EOPNOTSUPP && code != EISDIR && code != EINVAL)) {
+                    handleError(PTL_ERROR_REF(err), code, "cannot open anonymous temporary file in {}", cdir);
+                    return ret;
+                }
+            #endif
+            #if PTL_HAVE_MKOSTEMPS
+                std::string name = cdir;
+                if (name.empty())
+                    name = ".";
+                if (name.back() != '/')
+                    name += '/';
+                name += ".ptl-XXXXXX";
+                auto tempFd = FileDescriptor::openTemp(name.data(), 0, oflag & ~(O_RDONLY | O_WRONLY | O_RDWR | O_CREAT | O_EXCL), PTL_ERROR_REF(err));
+                if (!tempFd) 
+                    return ret;
+                ret.m_tempName = std::move(name);
+                ret.m_fd = std::move(tempFd);
+                if (::fchmod(ret.m_fd.get(), mode) != 0) {
+                    handleError(PTL_ERROR_REF(err), errno, "fchmod({}, 0{:o}) failed", ret.m_fd.get(), mode);
+                    ret = PendingFile();
+                }
+            #endif
+            return ret;
+        }
+
+        static auto create(PathLike auto && dir, int oflag, PTL_ERROR_REF_ARG(err)) -> PendingFile 
+        requires(PTL_ERROR_REQ(err)) {
+            return create(std::forward<decltype(dir)>(dir), oflag, S_IRUSR | S_IWUSR, PTL_ERROR_REF(err));
+        }
+
+        void publish(PathLike auto && path, PTL_ERROR_REF_ARG(err)) 
+        requires(PTL_ERROR_REQ(err)) {
+            if (!m_fd) {
+                throwErrorCode(EINVAL, "PendingFile is empty");
+            }
+            #if defined(O_TMPFILE) && defined(AT_EMPTY_PATH)
+            if (m_tempName.empty()) {
+                publishFile(m_fd, std::forward<decltype(path)>(path), PTL_ERROR_REF(err));
+                return;
+            }
+            #endif
+            #if PTL_HAVE_MKOSTEMPS
+                auto cpath = c_path(std::forward<decltype(path)>(path));
+                if (::link(m_tempName.c_str(), cpath) != 0) {
+                    handleError(PTL_ERROR_REF(err), errno, "link({}, {}) failed", m_tempName, cpath);
+                    return;
+                }
+                ::unlink(m_tempName.c_str());
+                m_tempName.clear();
+                clearError(PTL_ERROR_REF(err));
+            #endif
+        }
+
+        friend void swap(PendingFile & lhs, PendingFile & rhs) noexcept {
+            swap(lhs.m_fd, rhs.m_fd);
+            std::swap(lhs.m_tempName, rhs.m_tempName);
+        }
+
+        auto get() const noexcept -> int {
+            return m_fd.get();
+        }
+
+        auto isAnonymous() const noexcept -> bool {
+            return m_tempName.empty();
+        }
+
+        explicit operator bool() const noexcept {
+            return bool(m_fd);
+        }
+    private:
+        FileDescriptor m_fd;
+        std::string m_tempName;
+    };
+
+    template<> struct FileDescriptorTraits<PendingFile> {
+        [[gnu::always_inline]] static int c_fd(const PendingFile & file) noexcept
+            { return file.get();}
+    };
+    #endif
+
     #if !defined(_WIN32)
     class MemoryMap {
     public:
@@ -321,6 +493,277 @@ namespace ptl::inline v0 {
 
     #ifndef _WIN32
 
+    namespace impl {
+        using TransferDeadline = std::optional<std::chrono::steady_clock::time_point>;
+
+        //Waits until fd is ready for events or the deadline passes. Returns 0 or an errno value
+        inline auto waitForReadiness(int fd, short events, TransferDeadline deadline) noexcept -> int {
+            for ( ; ; ) {
+                int timeout = -1;
+                if (deadline) {
+                    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now());
+                    if (remaining.count() <= 0)
+                        return ETIMEDOUT;
+                    timeout = int(std::min(remaining.count(), decltype(remaining.count())(std::numeric_limits<int>::max())));
+                }
+                pollfd pfd{fd, events, 0};
+                int res = ::poll(&pfd, 1, timeout);
+                //errors and hangups are reported by the next transfer attempt
+                if (res > 0)
+                    return 0;
+                if (res < 0 && errno != EINTR)
+                    return errno;
+            }
+        }
+
+        //Repeats op() until total bytes are transferred, op() returns 0 (end of file) or fails. 
+        //op() performs a single call and returns its result with errno set on failure. 
+        //EINTR is retried and EAGAIN waits for readiness until the deadline.
+        template<class Op>
+        inline auto transferLoop(int fd, short events, size_t total, TransferDeadline deadline, Op && op, int & code) -> size_t {
+            size_t done = 0;
+            code = 0;
+            while (done < total) {
+                auto res = op();
+                if (res > 0) {
+                    done += size_t(res);
+                    continue;
+                }
+                if (res == 0)
+                    break;
+                int error = errno;
+                if (error == EINTR)
+                    continue;
+                if (error == EAGAIN || error == EWOULDBLOCK) {
+                    error = waitForReadiness(fd, events, deadline);
+                    if (error == 0)
+                        continue;
+                }
+                code = error;
+                break;
+            }
+            return done;
+        }
+
+        //Position within an array of iovec. Calls never modify the array itself.
+        class IoVecCursor {
+        public:
+            IoVecCursor(std::span<const ::iovec> iov) noexcept : m_iov(iov) 
+                { skipEmpty(); }
+
+            auto total() const noexcept -> size_t {
+                size_t ret = 0;
+                for (auto & item: m_iov)
+                    ret += item.iov_len;
+                return ret;
+            }
+            //true if the current element has been partially transferred
+            auto partial() const noexcept -> bool
+                { return m_offset != 0; }
+            auto current() const noexcept -> std::pair<std::byte *, size_t>
+                { return {static_cast<std::byte *>(m_iov[m_index].iov_base) + m_offset, m_iov[m_index].iov_len - m_offset}; }
+            auto remaining() const noexcept -> std::span<const ::iovec> {
+                constexpr size_t maxCount = IOV_MAX;
+                return m_iov.subspan(m_index, std::min(m_iov.size() - m_index, maxCount));
+            }
+            void advance(size_t count) noexcept {
+                while (count) {
+                    auto step = std::min(count, m_iov[m_index].iov_len - m_offset);
+                    m_offset += step;
+                    count -= step;
+                    if (m_offset == m_iov[m_index].iov_len) {
+                        ++m_index;
+                        m_offset = 0;
+                    }
+                }
+                skipEmpty();
+            }
+        private:
+            void skipEmpty() noexcept {
+                while (m_index < m_iov.size() && m_iov[m_index].iov_len == 0)
+                    ++m_index;
+            }
+        private:
+            std::span<const ::iovec> m_iov;
+            size_t m_index = 0;
+            size_t m_offset = 0;
+        };
+
+        inline auto writeAll(int fd, const void * buf, size_t nbyte, TransferDeadline deadline, int & code) -> size_t {
+            auto start = static_cast<const std::byte *>(buf);
+            size_t done = 0;
+            return transferLoop(fd, POLLOUT, nbyte, deadline, [&]() {
+                auto res = ::write(fd, start + done, nbyte - done);
+                if (res > 0)
+                    done += size_t(res);
+                return res;
+            }, code);
+        }
+
+        inline auto readExact(int fd, void * buf, size_t nbyte, TransferDeadline deadline, int & code) -> size_t {
+            auto start = static_cast<std::byte *>(buf);
+            size_t done = 0;
+            return transferLoop(fd, POLLIN, nbyte, deadline, [&]() {
+                auto res = ::read(fd, start + done, nbyte - done);
+                if (res > 0)
+                    done += size_t(res);
+                return res;
+            }, code);
+        }
+
+        inline auto writeAll(int fd, std::span<const ::iovec> iov, TransferDeadline deadline, int & code) -> size_t {
+            IoVecCursor cursor(iov);
+            return transferLoop(fd, POLLOUT, cursor.total(), deadline, [&]() {
+                ssize_t res;
+                if (cursor.partial()) {
+                    auto [ptr, size] = cursor.current();
+                    res = ::write(fd, ptr, size);
+                } else {
+                    auto rest = cursor.remaining();
+                    res = ::writev(fd, rest.data(), int(rest.size()));
+                }
+                if (res > 0)
+                    cursor.advance(size_t(res));
+                return res;
+            }, code);
+        }
+
+        inline auto readExact(int fd, std::span<const ::iovec> iov, TransferDeadline deadline, int & code) -> size_t {
+            IoVecCursor cursor(iov);
+            return transferLoop(fd, POLLIN, cursor.total(), deadline, [&]() {
+                ssize_t res;
+                if (cursor.partial()) {
+                    auto [ptr, size] = cursor.current();
+                    res = ::read(fd, ptr, size);
+                } else {
+                    auto rest = cursor.remaining();
+                    res = ::readv(fd, rest.data(), int(rest.size()));
+                }
+                if (res > 0)
+                    cursor.advance(size_t(res));
+                return res;
+            }, code);
+        }
+    }
+
+    //Writes all nbyte bytes retrying short writes and EINTR. On a non-blocking descriptor waits for it 
+    //to become writable. Returns the number of bytes written which is less than nbyte only on error.
+    inline auto writeAll(FileDescriptorLike auto && desc, const void * buf, size_t nbyte,
+                         PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::writeAll(fd, buf, nbyte, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "writeAll({}, ,{}) failed after {} bytes", fd, nbyte, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    //Same as above but fails with ETIMEDOUT if waiting for readiness extends past the deadline
+    inline auto writeAll(FileDescriptorLike auto && desc, const void * buf, size_t nbyte,
+                         std::chrono::steady_clock::time_point deadline,
+                         PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::writeAll(fd, buf, nbyte, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "writeAll({}, ,{}) failed after {} bytes", fd, nbyte, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto writeAll(FileDescriptorLike auto && desc, std::span<const ::iovec> iov,
+                         PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::writeAll(fd, iov, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "writeAll({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto writeAll(FileDescriptorLike auto && desc, std::span<const ::iovec> iov,
+                         std::chrono::steady_clock::time_point deadline,
+                         PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::writeAll(fd, iov, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "writeAll({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    //Reads exactly nbyte bytes retrying short reads and EINTR. On a non-blocking descriptor waits for it
+    //to become readable. Returns the number of bytes read which is less than nbyte on error or end of file.
+    //End of file is not an error.
+    inline auto readExact(FileDescriptorLike auto && desc, void * buf, size_t nbyte,
+                          PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::readExact(fd, buf, nbyte, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "readExact({}, ,{}) failed after {} bytes", fd, nbyte, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto readExact(FileDescriptorLike auto && desc, void * buf, size_t nbyte,
+                          std::chrono::steady_clock::time_point deadline,
+                          PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::readExact(fd, buf, nbyte, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "readExact({}, ,{}) failed after {} bytes", fd, nbyte, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto readExact(FileDescriptorLike auto && desc, std::span<const ::iovec> iov,
+                          PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::readExact(fd, iov, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "readExact({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto readExact(FileDescriptorLike auto && desc, std::span<const ::iovec> iov,
+                          std::chrono::steady_clock::time_point deadline,
+                          PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(desc)>(desc));
+        int code;
+        auto ret = impl::readExact(fd, iov, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "readExact({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    #endif
+
+    #ifndef _WIN32
+
     enum class FileLock : int {
         Shared = LOCK_SH,
         Exclusive = LOCK_EX
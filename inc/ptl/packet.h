@@ -0,0 +1,334 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef PTL_HEADER_PACKET_H_INCLUDED
+#define PTL_HEADER_PACKET_H_INCLUDED
+
+#include <ptl/core.h>
+#include <ptl/file.h>
+#include <ptl/socket.h>
+
+#if __has_include(<linux/if_packet.h>) && __has_include(<linux/if_ether.h>)
+    #include <linux/if_packet.h>
+    #include <linux/if_ether.h>
+    #include <sys/mman.h>
+    #include <poll.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <span>
+
+#if defined(PACKET_RX_RING) && defined(TPACKET3_HDRLEN)
+
+namespace ptl::inline v0 {
+
+    namespace impl {
+        //TPACKET_ALIGN and TPACKET3_HDRLEN without the signed arithmetic of the kernel macros
+        constexpr size_t PacketHeaderSize = (sizeof(::tpacket3_hdr) + TPACKET_ALIGNMENT - 1) & ~size_t(TPACKET_ALIGNMENT - 1);
+        constexpr size_t MinPacketFrameSize = PacketHeaderSize + sizeof(::sockaddr_ll);
+    }
+
+    //SOL_PACKET options
+    constexpr auto SockOptPacketVersion     = SockOptDesc<int>                  {SOL_PACKET, PACKET_VERSION};
+    constexpr auto SockOptPacketRxRing      = SockOptDesc<::tpacket_req3,
+                                                          ::tpacket_req>        {SOL_PACKET, PACKET_RX_RING};
+    constexpr auto SockOptPacketFanout      = SockOptDesc<int>                  {SOL_PACKET, PACKET_FANOUT};
+    constexpr auto SockOptPacketStatistics  = SockOptDesc<::tpacket_stats_v3,
+                                                          ::tpacket_stats>      {SOL_PACKET, PACKET_STATISTICS};
+
+    //A packet inside a PacketBlock. Data points directly into the capture ring.
+    class CapturedPacket {
+    public:
+        explicit CapturedPacket(const ::tpacket3_hdr * header) noexcept : m_header(header)
+        {}
+
+        //captured bytes starting at the link layer header, possibly fewer than length()
+        auto data() const noexcept -> std::span<const std::byte>
+            { return {reinterpret_cast<const std::byte *>(m_header) + m_header->tp_mac, m_header->tp_snaplen}; }
+        //original length of the packet on the wire
+        auto length() const noexcept -> size_t
+            { return m_header->tp_len; }
+        auto truncated() const noexcept -> bool
+            { return m_header->tp_snaplen < m_header->tp_len; }
+        //offset of the network layer header within data()
+        auto networkOffset() const noexcept -> size_t
+            { return size_t(m_header->tp_net) - m_header->tp_mac; }
+        auto timestamp() const noexcept -> std::chrono::system_clock::time_point
+            { return impl::timestampFromTimespec(::timespec{time_t(m_header->tp_sec), long(m_header->tp_nsec)}); }
+        //TP_STATUS_xxx flags
+        auto status() const noexcept -> uint32_t
+            { return m_header->tp_status; }
+        auto vlanTci() const noexcept -> std::optional<uint16_t> {
+            if (m_header->tp_status & TP_STATUS_VLAN_VALID)
+                return uint16_t(m_header->hv1.tp_vlan_tci);
+            return std::nullopt;
+        }
+        //only filled if requested via PacketCaptureSettings::fillRxHash
+        auto rxHash() const noexcept -> uint32_t
+            { return m_header->hv1.tp_rxhash; }
+        auto linkAddress() const noexcept -> const ::sockaddr_ll &
+            { return *reinterpret_cast<const ::sockaddr_ll *>(reinterpret_cast<const std::byte *>(m_header) + impl::PacketHeaderSize); }
+        auto interfaceIndex() const noexcept -> int
+            { return linkAddress().sll_ifindex; }
+        //PACKET_HOST, PACKET_OUTGOING etc.
+        auto packetType() const noexcept -> uint8_t
+            { return linkAddress().sll_pkttype; }
+    private:
+        const ::tpacket3_hdr * m_header;
+    };
+
+    //A block of the capture ring handed over to the user. The block is returned to the kernel when
+    //this object is destroyed or reset.
+    class PacketBlock {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = CapturedPacket;
+            using difference_type = ptrdiff_t;
+            using reference = CapturedPacket;
+            using pointer = void;
+
+            iterator() noexcept = default;
+            iterator(const ::tpacket3_hdr * header, uint32_t remaining) noexcept :
+                m_header(header), m_remaining(remaining)
+            {}
+
+            auto operator*() const noexcept -> CapturedPacket
+                { return CapturedPacket(m_header); }
+            auto operator++() noexcept -> iterator & {
+                if (--m_remaining)
+                    m_header = reinterpret_cast<const ::tpacket3_hdr *>(reinterpret_cast<const std::byte *>(m_header) + m_header->tp_next_offset);
+                else
+                    m_header = nullptr;
+                return *this;
+            }
+            auto operator++(int) noexcept -> iterator {
+                auto ret = *this;
+                ++*this;
+                return ret;
+            }
+            friend auto operator==(const iterator & lhs, const iterator & rhs) noexcept -> bool
+                { return lhs.m_header == rhs.m_header; }
+        private:
+            const ::tpacket3_hdr * m_header = nullptr;
+            uint32_t m_remaining = 0;
+        };
+
+        PacketBlock() noexcept = default;
+        explicit PacketBlock(::tpacket_block_desc * desc) noexcept : m_desc(desc)
+        {}
+        ~PacketBlock() noexcept
+            { reset(); }
+        PacketBlock(PacketBlock && src) noexcept : m_desc(std::exchange(src.m_desc, nullptr))
+        {}
+        PacketBlock & operator=(PacketBlock src) noexcept {
+            std::swap(m_desc, src.m_desc);
+            return *this;
+        }
+
+        //returns the block to the kernel
+        void reset() noexcept {
+            if (m_desc)
+                std::atomic_ref(std::exchange(m_desc, nullptr)->hdr.bh1.block_status).store(TP_STATUS_KERNEL, std::memory_order_release);
+        }
+
+        explicit operator bool() const noexcept
+            { return m_desc != nullptr; }
+
+        auto size() const noexcept -> size_t
+            { return m_desc ? m_desc->hdr.bh1.num_pkts : 0; }
+        auto empty() const noexcept -> bool
+            { return size() == 0; }
+        //sequence number of the block, incremented by the kernel for every block it fills
+        auto sequence() const noexcept -> uint64_t
+            { return m_desc ? m_desc->hdr.bh1.seq_num : 0; }
+        //the kernel had to drop packets because no free block was available before this one was filled
+        auto lossDetected() const noexcept -> bool
+            { return m_desc && (m_desc->hdr.bh1.block_status & TP_STATUS_LOSING); }
+
+        auto begin() const noexcept -> iterator {
+            if (empty())
+                return end();
+            auto first = reinterpret_cast<const std::byte *>(m_desc) + m_desc->hdr.bh1.offset_to_first_pkt;
+            return iterator(reinterpret_cast<const ::tpacket3_hdr *>(first), m_desc->hdr.bh1.num_pkts);
+        }
+        auto end() const noexcept -> iterator
+            { return iterator(); }
+    private:
+        ::tpacket_block_desc * m_desc = nullptr;
+    };
+
+    struct PacketCaptureSettings {
+        int protocol = ETH_P_ALL;                       //ETH_P_xxx in host byte order
+        int interfaceIndex = 0;                         //0 captures on all interfaces
+        unsigned blockSize = 1u << 20;                  //must be a multiple of the page size
+        unsigned blockCount = 64;
+        unsigned frameSize = 2048;                      //must be a multiple of TPACKET_ALIGNMENT dividing blockSize
+        std::chrono::milliseconds blockTimeout{100};    //a partially filled block is handed over after this time
+        bool fillRxHash = false;
+    };
+
+    struct PacketCaptureStatistics {
+        unsigned packets;
+        unsigned drops;
+        unsigned freezeCount;                           //number of times the ring was full
+    };
+
+    //Packet capture via an AF_PACKET socket with a memory-mapped TPACKET_V3 receive ring.
+    //Packets are read in place without copying, one block at a time.
+    class PacketCapture {
+    public:
+        PacketCapture() noexcept = default;
+
+        static auto create(const PacketCaptureSettings & settings,
+                           PTL_ERROR_REF_ARG(err)) -> PacketCapture
+        requires(PTL_ERROR_REQ(err)) {
+            if (settings.frameSize < impl::MinPacketFrameSize || settings.frameSize % TPACKET_ALIGNMENT != 0 ||
+                settings.blockSize == 0 || settings.blockSize % settings.frameSize != 0 || settings.blockCount == 0)
+                throwErrorCode(EINVAL, "invalid packet ring geometry: block size {}, block count {}, frame size {}",
+                               settings.blockSize, settings.blockCount, settings.frameSize);
+
+            PacketCapture ret;
+            //no protocol until bound so that nothing is queued before the ring is ready
+            ret.m_socket = createSocket(AF_PACKET, SOCK_RAW, 0, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+            setSocketOption(ret.m_socket, SockOptPacketVersion, int(TPACKET_V3), PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+
+            ::tpacket_req3 req{};
+            req.tp_block_size = settings.blockSize;
+            req.tp_block_nr = settings.blockCount;
+            req.tp_frame_size = settings.frameSize;
+            req.tp_frame_nr = (settings.blockSize / settings.frameSize) * settings.blockCount;
+            req.tp_retire_blk_tov = unsigned(settings.blockTimeout.count());
+            req.tp_feature_req_word = settings.fillRxHash ? TP_FT_REQ_FILL_RXHASH : 0;
+            setSocketOption(ret.m_socket, SockOptPacketRxRing, req, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+
+            ret.m_ring = MemoryMap(size_t(settings.blockSize) * settings.blockCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   ret.m_socket, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+            ret.m_blockSize = settings.blockSize;
+            ret.m_blockCount = settings.blockCount;
+
+            ::sockaddr_ll addr{};
+            addr.sll_family = AF_PACKET;
+            addr.sll_protocol = htons(uint16_t(settings.protocol));
+            addr.sll_ifindex = settings.interfaceIndex;
+            bindSocket(ret.m_socket, reinterpret_cast<const sockaddr *>(&addr), socklen_t(sizeof(addr)), PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+            return ret;
+        }
+
+        //Joins a fanout group spreading packets among all its member sockets.
+        //mode is PACKET_FANOUT_xxx optionally combined with PACKET_FANOUT_FLAG_xxx
+        void joinFanout(uint16_t groupId, int mode,
+                        PTL_ERROR_REF_ARG(err))
+        requires(PTL_ERROR_REQ(err)) {
+            setSocketOption(m_socket, SockOptPacketFanout, int(groupId) | (mode << 16), PTL_ERROR_REF(err));
+        }
+
+        //next block filled by the kernel or an empty PacketBlock if there is none yet (or the capture is not open)
+        auto tryNextBlock() noexcept -> PacketBlock {
+            if (!m_ring)
+                return {};
+            auto desc = blockAt(m_current);
+            if (!(std::atomic_ref(desc->hdr.bh1.block_status).load(std::memory_order_acquire) & TP_STATUS_USER))
+                return {};
+            m_current = (m_current + 1) % m_blockCount;
+            return PacketBlock(desc);
+        }
+
+        //waits up to timeout (indefinitely if negative) for the next block. Returns an empty PacketBlock on timeout
+        //or, with the error reported, when the socket has a pending error
+        auto nextBlock(std::chrono::milliseconds timeout,
+                       PTL_ERROR_REF_ARG(err)) -> PacketBlock
+        requires(PTL_ERROR_REQ(err)) {
+            if (!m_ring) {
+                handleError(PTL_ERROR_REF(err), EBADF, "packet capture is not open");
+                return {};
+            }
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            for ( ; ; ) {
+                if (auto block = tryNextBlock()) {
+                    clearError(PTL_ERROR_REF(err));
+                    return block;
+                }
+                int pollTimeout = -1;
+                if (timeout.count() >= 0) {
+                    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                    if (remaining.count() < 0)
+                        remaining = std::chrono::milliseconds(0);
+                    pollTimeout = int(std::min(remaining.count(), decltype(remaining.count())(std::numeric_limits<int>::max())));
+                }
+                pollfd pfd{m_socket.get(), POLLIN | POLLRDNORM | POLLERR, 0};
+                int res = ::poll(&pfd, 1, pollTimeout);
+                if (res < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    handleError(PTL_ERROR_REF(err), errno, "poll({}) failed", m_socket.get());
+                    return {};
+                }
+                if (res == 0) {
+                    clearError(PTL_ERROR_REF(err));
+                    return tryNextBlock();
+                }
+                if (pfd.revents & POLLNVAL) {
+                    handleError(PTL_ERROR_REF(err), EBADF, "poll({}) reported an invalid descriptor", m_socket.get());
+                    return {};
+                }
+                //a pending socket error, such as ENETDOWN when the interface goes away, keeps poll returning
+                //immediately. Reading SO_ERROR reports and clears it.
+                if (pfd.revents & POLLERR) {
+                    int code = 0;
+                    getSocketOption(m_socket, SockOptError, code, PTL_ERROR_REF(err));
+                    if (failed(PTL_ERROR_REF(err)))
+                        return {};
+                    if (code != 0) {
+                        handleError(PTL_ERROR_REF(err), code, "packet capture on socket {} failed", m_socket.get());
+                        return {};
+                    }
+                }
+            }
+        }
+
+        //statistics since the previous call
+        auto statistics(PTL_ERROR_REF_ARG(err)) -> PacketCaptureStatistics
+        requires(PTL_ERROR_REQ(err)) {
+            ::tpacket_stats_v3 stats{};
+            getSocketOption(m_socket, SockOptPacketStatistics, stats, PTL_ERROR_REF(err));
+            return {stats.tp_packets, stats.tp_drops, stats.tp_freeze_q_cnt};
+        }
+
+        auto socket() const noexcept -> const Socket &
+            { return m_socket; }
+        auto blockSize() const noexcept -> size_t
+            { return m_blockSize; }
+        auto blockCount() const noexcept -> size_t
+            { return m_blockCount; }
+
+        explicit operator bool() const noexcept
+            { return bool(m_socket); }
+    private:
+        auto blockAt(size_t index) const noexcept -> ::tpacket_block_desc *
+            { return reinterpret_cast<::tpacket_block_desc *>(static_cast<std::byte *>(m_ring.data()) + index * m_blockSize); }
+    private:
+        Socket m_socket;
+        MemoryMap m_ring;
+        size_t m_blockSize = 0;
+        size_t m_blockCount = 0;
+        size_t m_current = 0;
+    };
+}
+
+#endif
+
+#endif
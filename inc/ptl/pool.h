@@ -0,0 +1,433 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef PTL_HEADER_POOL_H_INCLUDED
+#define PTL_HEADER_POOL_H_INCLUDED
+
+#include <ptl/core.h>
+#include <ptl/file.h>
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+
+#include <sys/mman.h>
+
+namespace ptl::inline v0 {
+
+    struct BufferPoolSettings {
+        size_t bufferSize = 0;
+        size_t count = 0;
+        //buffers each thread keeps for itself before touching the shared free list.
+        //Limited to an eighth of count, with anything below 2 disabling the caches.
+        size_t cacheSize = 32;
+        //try MAP_HUGETLB first and fall back to transparent huge pages
+        bool hugePages = false;
+    };
+
+    struct BufferPoolStatistics {
+        //acquisitions that found no free buffer
+        uint64_t exhaustions = 0;
+        //buffers released by a thread other than the one that acquired them
+        uint64_t crossThreadReturns = 0;
+    };
+
+    namespace impl {
+
+        inline auto bufferPoolThreadTag() noexcept -> uint32_t {
+            static std::atomic<uint32_t> lastTag{0};
+            thread_local const uint32_t tag = ++lastTag;
+            return tag;
+        }
+
+        //A thread's private stack of free buffers. The owning thread holds busy around every use. Another 
+        //thread that finds the pool empty takes it briefly to move the buffers back to the shared list.
+        struct BufferPoolCache {
+            std::atomic_flag busy;
+            std::vector<uint32_t> items;
+
+            void lock() noexcept {
+                while (busy.test_and_set(std::memory_order_acquire))
+                    std::this_thread::yield();
+            }
+            auto tryLock() noexcept -> bool
+                { return !busy.test_and_set(std::memory_order_acquire); }
+            void unlock() noexcept
+                { busy.clear(std::memory_order_release); }
+        };
+
+        class BufferPoolState : public std::enable_shared_from_this<BufferPoolState> {
+        public:
+            static constexpr uint32_t None = std::numeric_limits<uint32_t>::max();
+            static constexpr size_t CacheLine = 64;
+
+            BufferPoolState(MemoryMap && memory, bool hugePages, const BufferPoolSettings & settings) :
+                m_memory(std::move(memory)),
+                m_next(new std::atomic<uint32_t>[settings.count]),
+                m_id(nextId()),
+                m_stride((settings.bufferSize + CacheLine - 1) / CacheLine * CacheLine),
+                m_bufferSize(settings.bufferSize),
+                m_count(uint32_t(settings.count)),
+                m_cacheSize(settings.cacheSize),
+                m_hugePages(hugePages) {
+
+                for (uint32_t i = 0; i < m_count; ++i)
+                    m_next[i].store(i + 1 < m_count ? i + 1 : None, std::memory_order_relaxed);
+                m_head.store(0, std::memory_order_release);
+            }
+
+            auto id() const noexcept -> uint64_t
+                { return m_id; }
+            auto bufferSize() const noexcept -> size_t
+                { return m_bufferSize; }
+            auto count() const noexcept -> size_t
+                { return m_count; }
+            auto cacheSize() const noexcept -> size_t
+                { return m_cacheSize; }
+            auto hugePages() const noexcept -> bool
+                { return m_hugePages; }
+            auto buffer(uint32_t idx) const noexcept -> std::span<std::byte>
+                { return {static_cast<std::byte *>(m_memory.data()) + idx * m_stride, m_bufferSize}; }
+
+            //Lock-free stack. The upper half of the head carries a tag bumped on every change
+            //so a stale head cannot be swapped in (ABA).
+            auto pop() noexcept -> uint32_t {
+                auto head = m_head.load(std::memory_order_acquire);
+                for ( ; ; ) {
+                    auto idx = uint32_t(head);
+                    if (idx == None)
+                        return None;
+                    auto next = m_next[idx].load(std::memory_order_relaxed);
+                    if (m_head.compare_exchange_weak(head, makeHead(next, head),
+                                                     std::memory_order_acquire, std::memory_order_acquire))
+                        return idx;
+                }
+            }
+
+            //pushes a whole chain with a single exchange
+            void push(std::span<const uint32_t> items) noexcept {
+                if (items.empty())
+                    return;
+                for (size_t i = 1; i < items.size(); ++i)
+                    m_next[items[i - 1]].store(items[i], std::memory_order_relaxed);
+                auto last = items.back();
+                auto head = m_head.load(std::memory_order_relaxed);
+                do {
+                    m_next[last].store(uint32_t(head), std::memory_order_relaxed);
+                } while (!m_head.compare_exchange_weak(head, makeHead(items.front(), head),
+                                                       std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            void attach(BufferPoolCache & cache) {
+                std::lock_guard lock(m_cachesMutex);
+                m_caches.push_back(&cache);
+            }
+            void detach(BufferPoolCache & cache) noexcept {
+                std::lock_guard lock(m_cachesMutex);
+                std::erase(m_caches, &cache);
+            }
+
+            //Moves whatever other threads hold in their caches to the shared free list and pops from it.
+            //Only used when both the caller's cache and the free list are empty.
+            auto steal(const BufferPoolCache & self) noexcept -> uint32_t {
+                {
+                    std::lock_guard lock(m_cachesMutex);
+                    for (auto * cache: m_caches) {
+                        if (cache == &self || !cache->tryLock())
+                            continue;
+                        push(cache->items);
+                        cache->items.clear();
+                        cache->unlock();
+                    }
+                }
+                return pop();
+            }
+
+            void countExhaustion() noexcept
+                { m_exhaustions.fetch_add(1, std::memory_order_relaxed); }
+            void countCrossThreadReturn() noexcept
+                { m_crossThreadReturns.fetch_add(1, std::memory_order_relaxed); }
+            auto statistics() const noexcept -> BufferPoolStatistics {
+                return {
+                    .exhaustions = m_exhaustions.load(std::memory_order_relaxed),
+                    .crossThreadReturns = m_crossThreadReturns.load(std::memory_order_relaxed)
+                };
+            }
+        private:
+            static auto nextId() noexcept -> uint64_t {
+                static std::atomic<uint64_t> lastId{0};
+                return ++lastId;
+            }
+            static auto makeHead(uint32_t idx, uint64_t prev) noexcept -> uint64_t
+                { return (((prev >> 32) + 1) << 32) | idx; }
+        private:
+            MemoryMap m_memory;
+            std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+            uint64_t m_id;
+            size_t m_stride;
+            size_t m_bufferSize;
+            uint32_t m_count;
+            size_t m_cacheSize;
+            bool m_hugePages;
+            alignas(CacheLine) std::atomic<uint64_t> m_head{None};
+            alignas(CacheLine) std::atomic<uint64_t> m_exhaustions{0};
+            std::atomic<uint64_t> m_crossThreadReturns{0};
+            std::mutex m_cachesMutex;
+            std::vector<BufferPoolCache *> m_caches;
+        };
+
+        //Per-thread caches of all pools the thread used. Whatever a thread still holds goes back
+        //to the shared free list when it exits, provided the pool is still alive.
+        class BufferPoolThreadCaches {
+        public:
+            struct Cache {
+                std::weak_ptr<BufferPoolState> pool;
+                uint64_t poolId;
+                //registered with the pool so it needs a stable address
+                std::unique_ptr<BufferPoolCache> cache;
+            };
+
+            ~BufferPoolThreadCaches() noexcept {
+                for (auto & cache: m_caches) {
+                    if (auto pool = cache.pool.lock()) {
+                        pool->detach(*cache.cache);
+                        pool->push(cache.cache->items);
+                    }
+                }
+            }
+
+            auto find(BufferPoolState & pool) -> BufferPoolCache & {
+                if (m_last < m_caches.size() && m_caches[m_last].poolId == pool.id())
+                    return *m_caches[m_last].cache;
+                for (size_t i = 0; i < m_caches.size(); ++i) {
+                    if (m_caches[i].poolId == pool.id())
+                        return *m_caches[m_last = i].cache;
+                }
+                std::erase_if(m_caches, [](const Cache & cache) { return cache.pool.expired(); });
+                auto cache = std::make_unique<BufferPoolCache>();
+                cache->items.reserve(pool.cacheSize());
+                //nothing may throw between attaching and storing the cache
+                m_caches.reserve(m_caches.size() + 1);
+                pool.attach(*cache);
+                auto & ret = *m_caches.emplace_back(Cache{pool.weak_from_this(), pool.id(), std::move(cache)}).cache;
+                m_last = m_caches.size() - 1;
+                return ret;
+            }
+
+            static auto instance() -> BufferPoolThreadCaches & {
+                thread_local BufferPoolThreadCaches caches;
+                return caches;
+            }
+        private:
+            std::vector<Cache> m_caches;
+            size_t m_last = 0;
+        };
+    }
+
+    class BufferPool;
+
+    //A buffer acquired from a BufferPool. Returns the buffer to the pool when destroyed or reset.
+    class PooledBuffer {
+    friend BufferPool;
+    public:
+        PooledBuffer() noexcept = default;
+        ~PooledBuffer() noexcept
+            { reset(); }
+        PooledBuffer(PooledBuffer && src) noexcept :
+            m_pool(std::exchange(src.m_pool, nullptr)), m_idx(src.m_idx), m_owner(src.m_owner)
+        {}
+        PooledBuffer & operator=(PooledBuffer src) noexcept {
+            std::swap(m_pool, src.m_pool);
+            std::swap(m_idx, src.m_idx);
+            std::swap(m_owner, src.m_owner);
+            return *this;
+        }
+
+        inline void reset() noexcept;
+
+        auto buffer() const noexcept -> std::span<std::byte>
+            { return m_pool ? m_pool->buffer(m_idx) : std::span<std::byte>(); }
+        auto data() const noexcept -> std::byte *
+            { return buffer().data(); }
+        auto size() const noexcept -> size_t
+            { return m_pool ? m_pool->bufferSize() : 0; }
+        auto index() const noexcept -> uint32_t
+            { return m_idx; }
+
+        explicit operator bool() const noexcept
+            { return m_pool != nullptr; }
+    private:
+        PooledBuffer(impl::BufferPoolState & pool, uint32_t idx) noexcept:
+            m_pool(&pool), m_idx(idx), m_owner(impl::bufferPoolThreadTag())
+        {}
+    private:
+        impl::BufferPoolState * m_pool = nullptr;
+        uint32_t m_idx = 0;
+        uint32_t m_owner = 0;
+    };
+
+    //A fixed set of equally sized buffers carved out of one memory map.
+    //Acquiring and releasing normally touches only a per-thread cache. The cache is refilled from
+    //and spilled to a lock-free free list shared by all threads.
+    class BufferPool {
+    friend PooledBuffer;
+    public:
+        BufferPool() noexcept = default;
+
+        static auto create(const BufferPoolSettings & settings,
+                           PTL_ERROR_REF_ARG(err)) -> BufferPool
+        requires(PTL_ERROR_REQ(err)) {
+            if (settings.bufferSize == 0)
+                throwErrorCode(EINVAL, "invalid buffer pool buffer size {}", settings.bufferSize);
+            if (settings.count == 0 || settings.count >= impl::BufferPoolState::None)
+                throwErrorCode(EINVAL, "invalid buffer pool size {}", settings.count);
+
+            constexpr auto line = impl::BufferPoolState::CacheLine;
+            const size_t stride = (settings.bufferSize + line - 1) / line * line;
+            if (stride > std::numeric_limits<size_t>::max() / settings.count)
+                throwErrorCode(EINVAL, "buffer pool of {} buffers of {} bytes is too large", settings.count, settings.bufferSize);
+            size_t size = stride * settings.count;
+
+            constexpr int prot = PROT_READ | PROT_WRITE;
+            constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+            MemoryMap memory;
+            bool hugePages = false;
+            #ifdef MAP_HUGETLB
+            if (settings.hugePages) {
+                constexpr size_t hugePageSize = 2 * 1024 * 1024;
+                std::error_code ec;
+                memory = MemoryMap((size + hugePageSize - 1) / hugePageSize * hugePageSize, prot, flags | MAP_HUGETLB, -1, ec);
+                hugePages = bool(memory);
+            }
+            #endif
+            if (!memory) {
+                memory = MemoryMap(size, prot, flags, -1, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+                #ifdef MADV_HUGEPAGE
+                if (settings.hugePages)
+                    ::madvise(memory.data(), memory.size(), MADV_HUGEPAGE);
+                #endif
+            }
+
+            //a single thread must not be able to hoard the pool in its cache
+            BufferPoolSettings adjusted = settings;
+            adjusted.cacheSize = std::min(settings.cacheSize, settings.count / 8);
+            if (adjusted.cacheSize < 2)
+                adjusted.cacheSize = 0;
+
+            BufferPool ret;
+            ret.m_state = std::make_shared<impl::BufferPoolState>(std::move(memory), hugePages, adjusted);
+            clearError(PTL_ERROR_REF(err));
+            return ret;
+        }
+
+        //An empty PooledBuffer if all buffers are in use
+        auto tryAcquire() -> PooledBuffer {
+            auto & state = *m_state;
+            auto cacheSize = state.cacheSize();
+            if (cacheSize == 0)
+                return makeBuffer(state.pop());
+
+            auto & cache = impl::BufferPoolThreadCaches::instance().find(state);
+            cache.lock();
+            if (cache.items.empty()) {
+                for (size_t i = 0, refill = cacheSize / 2; i < refill; ++i) {
+                    auto idx = state.pop();
+                    if (idx == impl::BufferPoolState::None)
+                        break;
+                    cache.items.push_back(idx);
+                }
+            }
+            auto idx = impl::BufferPoolState::None;
+            if (!cache.items.empty()) {
+                idx = cache.items.back();
+                cache.items.pop_back();
+            }
+            cache.unlock();
+            //free buffers may still sit in other threads' caches
+            if (idx == impl::BufferPoolState::None)
+                idx = state.steal(cache);
+            return makeBuffer(idx);
+        }
+
+        //Fails with ENOBUFS if all buffers are in use
+        auto acquire(PTL_ERROR_REF_ARG(err)) -> PooledBuffer
+        requires(PTL_ERROR_REQ(err)) {
+            auto ret = tryAcquire();
+            if (!ret)
+                handleError(PTL_ERROR_REF(err), ENOBUFS, "buffer pool of {} buffers is exhausted", m_state->count());
+            else
+                clearError(PTL_ERROR_REF(err));
+            return ret;
+        }
+
+        auto bufferSize() const noexcept -> size_t
+            { return m_state->bufferSize(); }
+        auto count() const noexcept -> size_t
+            { return m_state->count(); }
+        //per-thread cache size in effect after limiting the requested one
+        auto cacheSize() const noexcept -> size_t
+            { return m_state->cacheSize(); }
+        //whether the memory is backed by explicit huge pages
+        auto hugePages() const noexcept -> bool
+            { return m_state->hugePages(); }
+        auto statistics() const noexcept -> BufferPoolStatistics
+            { return m_state->statistics(); }
+
+        explicit operator bool() const noexcept
+            { return bool(m_state); }
+    private:
+        auto makeBuffer(uint32_t idx) -> PooledBuffer {
+            if (idx == impl::BufferPoolState::None) {
+                m_state->countExhaustion();
+                return {};
+            }
+            return PooledBuffer(*m_state, idx);
+        }
+
+        static void release(impl::BufferPoolState & state, uint32_t idx, uint32_t owner) noexcept {
+            if (owner != impl::bufferPoolThreadTag())
+                state.countCrossThreadReturn();
+            auto cacheSize = state.cacheSize();
+            if (cacheSize == 0) {
+                state.push({&idx, 1});
+                return;
+            }
+            impl::BufferPoolCache * cache;
+            try {
+                cache = &impl::BufferPoolThreadCaches::instance().find(state);
+            } catch(...) {
+                //no memory for a new thread cache
+                state.push({&idx, 1});
+                return;
+            }
+            cache->lock();
+            cache->items.push_back(idx);
+            if (cache->items.size() >= cacheSize) {
+                //keep half so that alternating acquire and release does not bounce
+                auto spill = std::span<const uint32_t>(cache->items).subspan(cacheSize / 2);
+                state.push(spill);
+                cache->items.resize(cacheSize / 2);
+            }
+            cache->unlock();
+        }
+    private:
+        std::shared_ptr<impl::BufferPoolState> m_state;
+    };
+
+    inline void PooledBuffer::reset() noexcept {
+        if (m_pool)
+            BufferPool::release(*std::exchange(m_pool, nullptr), m_idx, m_owner);
+    }
+}
+
+#endif
+
+#endif
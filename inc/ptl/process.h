@@ -5,9 +5,11 @@
 #define PTL_HEADER_PROCESS_H_INCLUDED
 
 #include <ptl/core.h>
+#include <ptl/file.h>
 
 #include <optional>
 #include <cassert>
+#include <chrono>
 
 #include <sys/types.h>
 #if __has_include(<sys/wait.h>)
@@ -18,6 +20,12 @@
 #include <process.h>
 #endif
 
+#if PTL_HAVE_PIDFD
+    #include <sys/syscall.h>
+    #include <poll.h>
+    #include <signal.h>
+#endif
+
 namespace ptl::inline v0 {
 
     #if defined(_WIN32) && !defined(__MINGW32__)
@@ -50,6 +58,31 @@ namespace ptl::inline v0 {
     [[gnu::always_inline]] inline pid_t c_pid(T && obj)
         { return ProcessTraits<std::remove_cvref_t<T>>::c_pid(std::forward<T>(obj)); }
 
+    #if PTL_HAVE_PIDFD
+    namespace impl {
+        inline int pidfdOpen(pid_t pid, unsigned flags) noexcept
+            { return int(::syscall(__NR_pidfd_open, pid, flags)); }
+        inline int pidfdSendSignal(int pidfd, int sig) noexcept
+            { return int(::syscall(__NR_pidfd_send_signal, pidfd, sig, nullptr, 0)); }
+
+        //P_PIDFD is missing from older C library headers
+        constexpr auto PidfdIdType = idtype_t(3);
+
+        //waitid() result in the form returned by waitpid()
+        inline int waitStatus(const siginfo_t & info) noexcept {
+            switch(info.si_code) {
+                case CLD_EXITED: return (info.si_status & 0xff) << 8;
+                case CLD_KILLED: return info.si_status;
+                case CLD_DUMPED: return info.si_status | 0x80;
+                case CLD_STOPPED:
+                case CLD_TRAPPED: return (info.si_status << 8) | 0x7f;
+                case CLD_CONTINUED: return 0xffff;
+            }
+            return 0;
+        }
+    }
+    #endif
+
 
     class ChildProcess {
     public:
@@ -69,7 +102,12 @@ namespace ptl::inline v0 {
                 }
             }
         }
-        ChildProcess(ChildProcess && src) noexcept : m_pid(src.m_pid) {
+        ChildProcess(ChildProcess && src) noexcept : 
+            m_pid(src.m_pid)
+            #if PTL_HAVE_PIDFD
+            , m_pidfd(std::move(src.m_pidfd))
+            #endif
+        {
             src.m_pid = 0;
         }
         
@@ -81,6 +119,9 @@ namespace ptl::inline v0 {
         
         friend void swap(ChildProcess & lhs, ChildProcess & rhs) noexcept {
             std::swap(lhs.m_pid, rhs.m_pid);
+            #if PTL_HAVE_PIDFD
+            swap(lhs.m_pidfd, rhs.m_pidfd);
+            #endif
         }
         
         auto get() const noexcept -> pid_t {
@@ -90,6 +131,9 @@ namespace ptl::inline v0 {
         auto detach() noexcept -> pid_t {
             pid_t ret = m_pid;
             m_pid = 0;
+            #if PTL_HAVE_PIDFD
+            m_pidfd.close();
+            #endif
             return ret;
         }
         
@@ -111,7 +155,7 @@ namespace ptl::inline v0 {
                 clearError(PTL_ERROR_REF(err));
                 #ifndef _WIN32
                 if (WIFEXITED(stat) || WIFSIGNALED(stat))
-                    m_pid = 0;
+                    reaped();
                 #else
                     m_pid = 0;
                 #endif
@@ -127,8 +171,98 @@ namespace ptl::inline v0 {
             return wait(0, PTL_ERROR_REF(err));
         }
 
+        #if PTL_HAVE_PIDFD
+        //Opens a pidfd for the child if it does not have one yet. Until the child is waited for
+        //its pid cannot be reused, so the descriptor refers to this child. This does not hold if children 
+        //are reaped automatically (SIGCHLD set to SIG_IGN or SA_NOCLDWAIT): an exited child can then be gone 
+        //and its pid reused before this is called.
+        void openPidfd(PTL_ERROR_REF_ARG(err))
+        requires(PTL_ERROR_REQ(err)) {
+            if (m_pid == 0) {
+                throwErrorCode(EINVAL, "ChildProcess not started or has already been waited for");
+            }
+            if (!m_pidfd) {
+                int fd = impl::pidfdOpen(m_pid, 0);
+                if (fd < 0) {
+                    handleError(PTL_ERROR_REF(err), errno, "pidfd_open({}) failed", m_pid);
+                    return;
+                }
+                m_pidfd = FileDescriptor(fd);
+            }
+            clearError(PTL_ERROR_REF(err));
+        }
+
+        //Becomes readable when the child terminates. Empty unless opened.
+        auto pidfd() const noexcept -> const FileDescriptor & {
+            return m_pidfd;
+        }
+
+        //Waits for the child to terminate for at most timeout. Opens the pidfd if necessary.
+        //Returns std::nullopt on timeout.
+        template<class Rep, class Period>
+        auto wait(std::chrono::duration<Rep, Period> timeout, 
+                  PTL_ERROR_REF_ARG(err)) -> std::optional<int> 
+        requires(PTL_ERROR_REQ(err)) {
+            openPidfd(PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return std::nullopt;
+
+            using namespace std::chrono;
+            const auto deadline = steady_clock::now() + ceil<steady_clock::duration>(timeout);
+            for ( ; ; ) {
+                auto remaining = ceil<milliseconds>(deadline - steady_clock::now()).count();
+                pollfd pfd{m_pidfd.get(), POLLIN, 0};
+                int res = ::poll(&pfd, 1, int(std::clamp(remaining, decltype(remaining)(0), decltype(remaining)(std::numeric_limits<int>::max()))));
+                if (res > 0)
+                    break;
+                if (res == 0) {
+                    if (remaining <= 0) {
+                        clearError(PTL_ERROR_REF(err));
+                        return std::nullopt;
+                    }
+                    continue;
+                }
+                if (errno != EINTR) {
+                    handleError(PTL_ERROR_REF(err), errno, "poll() on pidfd of {} failed", m_pid);
+                    return std::nullopt;
+                }
+            }
+
+            siginfo_t info{};
+            //P_PIDFD needs Linux 5.4 while pidfd_open is in 5.3. Waiting by pid is just as safe: 
+            //it cannot be reused before the child is reaped.
+            idtype_t idType = impl::PidfdIdType;
+            id_t id = id_t(m_pidfd.get());
+            while (::waitid(idType, id, &info, WEXITED) != 0) {
+                if (errno == EINVAL && idType == impl::PidfdIdType) {
+                    idType = P_PID;
+                    id = id_t(m_pid);
+                    continue;
+                }
+                if (errno != EINTR) {
+                    handleError(PTL_ERROR_REF(err), errno, "waitid() for {} failed", m_pid);
+                    return std::nullopt;
+                }
+            }
+            reaped();
+            clearError(PTL_ERROR_REF(err));
+            return impl::waitStatus(info);
+        }
+        #endif
+
+    private:
+        void reaped() noexcept {
+            m_pid = 0;
+            #if PTL_HAVE_PIDFD
+            m_pidfd.close();
+            #endif
+        }
+
     private:
         pid_t m_pid = 0;
+        #if PTL_HAVE_PIDFD
+        FileDescriptor m_pidfd;
+        #endif
     };
 
 
@@ -141,6 +275,22 @@ namespace ptl::inline v0 {
             { return proc.get();}
     };
 
+    #if PTL_HAVE_PIDFD
+    //Opens a pidfd for any process. Unlike ChildProcess::openPidfd this is subject to pid
+    //reuse: by the time it is called pid may refer to a different process.
+    inline auto openPidfd(ProcessLike auto && proc, unsigned flags,
+                          PTL_ERROR_REF_ARG(err)) -> FileDescriptor
+    requires(PTL_ERROR_REQ(err)) {
+        auto pid = c_pid(std::forward<decltype(proc)>(proc));
+        FileDescriptor ret(impl::pidfdOpen(pid, flags));
+        if (!ret)
+            handleError(PTL_ERROR_REF(err), errno, "pidfd_open({}, {}) failed", pid, flags);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+    #endif
+
     #ifndef _WIN32
 
     inline auto setSessionId(PTL_ERROR_REF_ARG(err)) -> pid_t
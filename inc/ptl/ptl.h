@@ -4,14 +4,18 @@
 #ifndef PTL_HEADER_PTL_H_INCLUDED
 #define PTL_HEADER_PTL_H_INCLUDED
 
+#include <ptl/async.h>
 #include <ptl/errors.h>
 #include <ptl/file.h>
 #include <ptl/identity.h>
+#include <ptl/packet.h>
+#include <ptl/pool.h>
 #include <ptl/process.h>
 #include <ptl/signal.h>
 #include <ptl/socket.h>
 #include <ptl/spawn.h>
 #include <ptl/system.h>
+#include <ptl/uring.h>
 #include <ptl/users.h>
 #include <ptl/util.h>
 
@@ -92,9 +92,29 @@ namespace ptl::inline v0 {
         return std::to_string(sig);
     }
 
+    #if PTL_HAVE_PIDFD
+    inline void sendPidfdSignal(FileDescriptorLike auto && pidfd, int sig, PTL_ERROR_REF_ARG(err)) 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_fd(std::forward<decltype(pidfd)>(pidfd));
+        if (impl::pidfdSendSignal(fd, sig) != 0)
+            handleError(PTL_ERROR_REF(err), errno, "pidfd_send_signal({}, {}) failed", fd, sig);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+    #endif
+
     #ifndef __MINGW32__
+    //A ChildProcess with an open pidfd is signalled through it, which is immune to pid reuse
     inline void sendSignal(ProcessLike auto && proc, int sig, PTL_ERROR_REF_ARG(err)) 
     requires(PTL_ERROR_REQ(err)) {
+        #if PTL_HAVE_PIDFD
+        if constexpr (std::is_same_v<std::remove_cvref_t<decltype(proc)>, ChildProcess>) {
+            if (proc.pidfd()) {
+                sendPidfdSignal(proc.pidfd(), sig, PTL_ERROR_REF(err));
+                return;
+            }
+        }
+        #endif
         clearError(PTL_ERROR_REF(err));
         auto pid = c_pid(std::forward<decltype(proc)>(proc));
         int res = ::kill(pid, sig);
@@ -15,6 +15,33 @@
 #if __has_include(<netinet/in.h>)
     #include <netinet/in.h>
 #endif
+#if __has_include(<sys/un.h>)
+    #include <sys/un.h>
+#endif
+#if __has_include(<netinet/tcp.h>)
+    #include <netinet/tcp.h>
+#endif
+#if __has_include(<netinet/udp.h>)
+    #include <netinet/udp.h>
+#endif
+#if __has_include(<linux/filter.h>)
+    #include <linux/filter.h>
+#endif
+#if __has_include(<linux/errqueue.h>)
+    #include <linux/errqueue.h>
+#endif
+#if __has_include(<linux/net_tstamp.h>)
+    #include <linux/net_tstamp.h>
+#endif
+#if __has_include(<linux/tls.h>)
+    #include <linux/tls.h>
+#endif
+#if __has_include(<sys/ioctl.h>)
+    #include <sys/ioctl.h>
+#endif
+#if __has_include(<linux/sockios.h>)
+    #include <linux/sockios.h>
+#endif
 
 #ifdef _WIN32
     #ifndef NOMINMAX
@@ -30,8 +57,21 @@
     #endif
 #else
     #include <sys/time.h>
+    #include <time.h>
+    #include <poll.h>
 #endif
 
+#include <span>
+#include <array>
+#include <bit>
+#include <string_view>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <variant>
+#include <cassert>
+#include <string.h>
+
 namespace ptl::inline v0 {
 
     #ifndef _WIN32
@@ -142,6 +182,569 @@ namespace ptl::inline v0 {
         }
     }
 
+    namespace impl {
+        constexpr auto hostToNet(uint16_t val) noexcept -> uint16_t {
+            if constexpr (std::endian::native == std::endian::little)
+                return uint16_t((val >> 8) | (val << 8));
+            else
+                return val;
+        }
+        constexpr auto hostToNet(uint32_t val) noexcept -> uint32_t {
+            if constexpr (std::endian::native == std::endian::little)
+                return (val >> 24) | ((val >> 8) & 0xFF00u) | ((val << 8) & 0xFF0000u) | (val << 24);
+            else
+                return val;
+        }
+        constexpr auto netToHost(uint16_t val) noexcept -> uint16_t 
+            { return hostToNet(val); }
+        constexpr auto netToHost(uint32_t val) noexcept -> uint32_t 
+            { return hostToNet(val); }
+
+        constexpr auto decimalDigit(char c) noexcept -> unsigned 
+            { return unsigned(c) - unsigned('0'); }
+
+        constexpr auto hexDigit(char c) noexcept -> unsigned {
+            if (unsigned(c) - unsigned('0') < 10)
+                return unsigned(c) - unsigned('0');
+            unsigned lower = unsigned(c) | 0x20u;
+            if (lower - unsigned('a') < 6)
+                return lower - unsigned('a') + 10;
+            return 16;
+        }
+
+        //Strict dotted quad, same rules as inet_pton: exactly 4 decimal parts, no leading zeroes
+        constexpr auto parseIPv4Text(std::string_view text, uint32_t & dest) noexcept -> bool {
+            uint32_t result = 0;
+            size_t pos = 0;
+            for (int part = 0; part < 4; ++part) {
+                if (part != 0) {
+                    if (pos == text.size() || text[pos] != '.')
+                        return false;
+                    ++pos;
+                }
+                size_t start = pos;
+                unsigned val = 0;
+                for ( ; pos < text.size() && pos - start < 3; ++pos) {
+                    unsigned digit = decimalDigit(text[pos]);
+                    if (digit > 9)
+                        break;
+                    val = val * 10 + digit;
+                }
+                size_t len = pos - start;
+                if (len == 0 || val > 255 || (len > 1 && text[start] == '0'))
+                    return false;
+                result = (result << 8) | val;
+            }
+            if (pos != text.size())
+                return false;
+            dest = result;
+            return true;
+        }
+
+        //RFC 4291 text form including "::" compression and a trailing dotted quad
+        constexpr auto parseIPv6Text(std::string_view text, std::array<uint8_t, 16> & dest) noexcept -> bool {
+            uint16_t words[8] = {};
+            size_t count = 0;
+            size_t gap = 8;
+            size_t pos = 0;
+            if (text.size() >= 2 && text[0] == ':' && text[1] == ':') {
+                gap = 0;
+                pos = 2;
+            } else if (text.empty() || text[0] == ':') {
+                return false;
+            }
+            while (pos < text.size()) {
+                size_t start = pos;
+                unsigned val = 0;
+                for ( ; pos < text.size() && pos - start < 4; ++pos) {
+                    unsigned digit = hexDigit(text[pos]);
+                    if (digit > 15)
+                        break;
+                    val = (val << 4) | digit;
+                }
+                if (pos < text.size() && text[pos] == '.') {
+                    uint32_t v4 = 0;
+                    if (count > 6 || !parseIPv4Text(text.substr(start), v4))
+                        return false;
+                    words[count++] = uint16_t(v4 >> 16);
+                    words[count++] = uint16_t(v4);
+                    break;
+                }
+                if (pos == start || count == 8)
+                    return false;
+                words[count++] = uint16_t(val);
+                if (pos == text.size())
+                    break;
+                if (text[pos] != ':' || ++pos == text.size())
+                    return false;
+                if (text[pos] == ':') {
+                    if (gap != 8)
+                        return false;
+                    gap = count;
+                    ++pos;
+                }
+            }
+            if (gap == 8) {
+                if (count != 8)
+                    return false;
+            } else {
+                if (count == 8)
+                    return false;
+                size_t tail = count - gap;
+                for (size_t i = 0; i < tail; ++i) {
+                    words[7 - i] = words[count - 1 - i];
+                    words[count - 1 - i] = 0;
+                }
+            }
+            for (size_t i = 0; i < 8; ++i) {
+                dest[2 * i] = uint8_t(words[i] >> 8);
+                dest[2 * i + 1] = uint8_t(words[i]);
+            }
+            return true;
+        }
+
+        constexpr auto formatDecimal(uint32_t val, char * dest) noexcept -> char * {
+            char buf[10];
+            char * p = buf + sizeof(buf);
+            do {
+                *--p = char('0' + val % 10);
+                val /= 10;
+            } while (val);
+            while (p != buf + sizeof(buf))
+                *dest++ = *p++;
+            return dest;
+        }
+
+        constexpr auto formatIPv4Text(uint32_t addr, char * dest) noexcept -> char * {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                unsigned octet = (addr >> shift) & 0xFF;
+                if (octet >= 100) {
+                    *dest++ = char('0' + octet / 100);
+                    octet %= 100;
+                    *dest++ = char('0' + octet / 10);
+                } else if (octet >= 10) {
+                    *dest++ = char('0' + octet / 10);
+                }
+                *dest++ = char('0' + octet % 10);
+                if (shift)
+                    *dest++ = '.';
+            }
+            return dest;
+        }
+
+        //RFC 5952 canonical form
+        constexpr auto formatIPv6Text(const uint8_t * bytes, char * dest) noexcept -> char * {
+            constexpr char hexDigits[] = "0123456789abcdef";
+            unsigned words[8] = {};
+            for (size_t i = 0; i < 8; ++i)
+                words[i] = unsigned(bytes[2 * i]) << 8 | bytes[2 * i + 1];
+
+            if (words[0] == 0 && words[1] == 0 && words[2] == 0 && words[3] == 0 && words[4] == 0 && words[5] == 0xFFFF) {
+                for (char c: std::string_view("::ffff:"))
+                    *dest++ = c;
+                return formatIPv4Text(uint32_t(words[6]) << 16 | words[7], dest);
+            }
+
+            size_t bestStart = 8, bestLen = 1;
+            for (size_t i = 0; i < 8; ) {
+                if (words[i] != 0) {
+                    ++i;
+                    continue;
+                }
+                size_t start = i;
+                while (i < 8 && words[i] == 0)
+                    ++i;
+                if (i - start > bestLen) {
+                    bestStart = start;
+                    bestLen = i - start;
+                }
+            }
+            for (size_t i = 0; i < 8; ) {
+                if (i == bestStart) {
+                    *dest++ = ':';
+                    if (i == 0)
+                        *dest++ = ':';
+                    i += bestLen;
+                    continue;
+                }
+                unsigned word = words[i];
+                bool started = false;
+                for (int shift = 12; shift >= 0; shift -= 4) {
+                    unsigned digit = (word >> shift) & 0xF;
+                    if (digit || started || shift == 0) {
+                        *dest++ = hexDigits[digit];
+                        started = true;
+                    }
+                }
+                if (++i < 8)
+                    *dest++ = ':';
+            }
+            return dest;
+        }
+
+        constexpr auto parsePort(std::string_view text, uint16_t & dest) noexcept -> bool {
+            if (text.empty() || text.size() > 5)
+                return false;
+            unsigned val = 0;
+            for (char c: text) {
+                unsigned digit = decimalDigit(c);
+                if (digit > 9)
+                    return false;
+                val = val * 10 + digit;
+            }
+            if (val > 0xFFFF)
+                return false;
+            dest = uint16_t(val);
+            return true;
+        }
+    }
+
+    constexpr size_t MaxIPv4AddressTextLength = 15;     //255.255.255.255
+    constexpr size_t MaxIPv6AddressTextLength = 45;     //ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255
+
+    inline auto parseIPv4Address(std::string_view text, in_addr & dest) noexcept -> bool {
+        uint32_t addr = 0;
+        if (!impl::parseIPv4Text(text, addr))
+            return false;
+        dest.s_addr = impl::hostToNet(addr);
+        return true;
+    }
+
+    inline auto parseIPv6Address(std::string_view text, in6_addr & dest) noexcept -> bool {
+        std::array<uint8_t, 16> addr{};
+        if (!impl::parseIPv6Text(text, addr))
+            return false;
+        memcpy(&dest, addr.data(), addr.size());
+        return true;
+    }
+
+    //dest must have room for MaxIPv4AddressTextLength characters. Returns the end of written text. 
+    inline auto formatIPv4Address(const in_addr & addr, char * dest) noexcept -> char * {
+        return impl::formatIPv4Text(impl::netToHost(uint32_t(addr.s_addr)), dest);
+    }
+
+    //dest must have room for MaxIPv6AddressTextLength characters. Returns the end of written text. 
+    inline auto formatIPv6Address(const in6_addr & addr, char * dest) noexcept -> char * {
+        uint8_t bytes[16];
+        memcpy(bytes, &addr, sizeof(bytes));
+        return impl::formatIPv6Text(bytes, dest);
+    }
+
+    class SocketAddress {
+    private:
+        union Storage {
+            sockaddr_storage any;
+            sockaddr_in in4;
+            sockaddr_in6 in6;
+        #ifndef _WIN32
+            sockaddr_un un;
+        #endif
+        };
+    public:
+        static constexpr socklen_t capacity = socklen_t(sizeof(Storage));
+
+        constexpr SocketAddress() noexcept:
+            m_storage{.any = {}} {
+        }
+
+        SocketAddress(const sockaddr * address, socklen_t address_len):
+            m_storage{.any = {}} {
+            
+            if (size_t(address_len) > size_t(capacity))
+                throwErrorCode(EINVAL, "socket address length {} exceeds maximum supported {}", address_len, capacity);
+            memcpy(&m_storage, address, size_t(address_len));
+            m_length = address_len;
+        }
+
+        static constexpr auto ipv4(std::array<uint8_t, 4> addr, uint16_t port) noexcept -> SocketAddress {
+            return ipv4(uint32_t(addr[0]) << 24 | uint32_t(addr[1]) << 16 | uint32_t(addr[2]) << 8 | uint32_t(addr[3]), port);
+        }
+
+        static constexpr auto ipv4(uint32_t addr, uint16_t port) noexcept -> SocketAddress {
+            SocketAddress ret;
+            ret.m_storage.in4 = sockaddr_in{};
+            ret.m_storage.in4.sin_family = AF_INET;
+            ret.m_storage.in4.sin_port = impl::hostToNet(port);
+            ret.m_storage.in4.sin_addr.s_addr = impl::hostToNet(addr);
+            ret.m_length = socklen_t(sizeof(sockaddr_in));
+        #if PTL_HAVE_SOCKADDR_SA_LEN
+            ret.m_storage.in4.sin_len = uint8_t(sizeof(sockaddr_in));
+        #endif
+            return ret;
+        }
+
+        static constexpr auto ipv6(std::array<uint8_t, 16> addr, uint16_t port, uint32_t scopeId = 0) noexcept -> SocketAddress {
+            SocketAddress ret;
+            ret.m_storage.in6 = sockaddr_in6{};
+            ret.m_storage.in6.sin6_family = AF_INET6;
+            ret.m_storage.in6.sin6_port = impl::hostToNet(port);
+            for (size_t i = 0; i < addr.size(); ++i)
+                ret.m_storage.in6.sin6_addr.s6_addr[i] = addr[i];
+            ret.m_storage.in6.sin6_scope_id = scopeId;
+            ret.m_length = socklen_t(sizeof(sockaddr_in6));
+        #if PTL_HAVE_SOCKADDR_SA_LEN
+            ret.m_storage.in6.sin6_len = uint8_t(sizeof(sockaddr_in6));
+        #endif
+            return ret;
+        }
+
+        #ifndef _WIN32
+        static constexpr auto unixPath(std::string_view path) -> SocketAddress {
+            SocketAddress ret;
+            ret.m_storage.un = sockaddr_un{};
+            if (path.size() >= sizeof(ret.m_storage.un.sun_path))
+                throwErrorCode(ENAMETOOLONG, "unix socket path of size {} exceeds maximum supported {}", path.size(), sizeof(ret.m_storage.un.sun_path) - 1);
+            ret.m_storage.un.sun_family = AF_UNIX;
+            for (size_t i = 0; i < path.size(); ++i)
+                ret.m_storage.un.sun_path[i] = path[i];
+            ret.m_length = socklen_t(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+        #if PTL_HAVE_SOCKADDR_SA_LEN
+            ret.m_storage.un.sun_len = uint8_t(ret.m_length);
+        #endif
+            return ret;
+        }
+        #endif
+
+        #ifdef __linux__
+        static constexpr auto unixAbstract(std::string_view name) -> SocketAddress {
+            SocketAddress ret;
+            ret.m_storage.un = sockaddr_un{};
+            if (name.size() >= sizeof(ret.m_storage.un.sun_path))
+                throwErrorCode(ENAMETOOLONG, "abstract unix socket name of size {} exceeds maximum supported {}", name.size(), sizeof(ret.m_storage.un.sun_path) - 1);
+            ret.m_storage.un.sun_family = AF_UNIX;
+            for (size_t i = 0; i < name.size(); ++i)
+                ret.m_storage.un.sun_path[i + 1] = name[i];
+            ret.m_length = socklen_t(offsetof(sockaddr_un, sun_path) + name.size() + 1);
+            return ret;
+        }
+        #endif
+
+        //Accepts "1.2.3.4", "1.2.3.4:80", "::1", "[::1]:80" and "[fe80::1%2]:80" with a numeric scope id.
+        //The port is 0 if not specified.
+        static constexpr auto parse(std::string_view text) noexcept -> std::optional<SocketAddress> {
+            uint16_t port = 0;
+            if (!text.empty() && text[0] == '[') {
+                auto close = text.find(']');
+                if (close == text.npos)
+                    return std::nullopt;
+                auto rest = text.substr(close + 1);
+                if (!rest.empty() && (rest[0] != ':' || !impl::parsePort(rest.substr(1), port)))
+                    return std::nullopt;
+                return parseIPv6WithScope(text.substr(1, close - 1), port);
+            }
+            auto colon = text.find(':');
+            if (colon == text.npos) {
+                uint32_t addr = 0;
+                if (!impl::parseIPv4Text(text, addr))
+                    return std::nullopt;
+                return ipv4(addr, port);
+            }
+            if (text.find(':', colon + 1) != text.npos)
+                return parseIPv6WithScope(text, port);
+            uint32_t addr = 0;
+            if (!impl::parseIPv4Text(text.substr(0, colon), addr) || !impl::parsePort(text.substr(colon + 1), port))
+                return std::nullopt;
+            return ipv4(addr, port);
+        }
+
+        static constexpr size_t maxTextLength = std::max(
+            size_t(1 + MaxIPv6AddressTextLength + 1 + 10 + 2 + 5),  //[addr%scope]:port
+        #ifndef _WIN32
+            sizeof(sockaddr_un::sun_path) + 1
+        #else
+            size_t(0)
+        #endif
+        );
+
+        //IP addresses are formatted as "1.2.3.4:80" and "[::1%2]:80", Unix paths as is and 
+        //abstract names with a leading '@'.
+        //dest must have room for maxTextLength characters. Returns the end of written text.
+        auto formatTo(char * dest) const noexcept -> char * {
+            if (auto in4 = asIPv4()) {
+                dest = formatIPv4Address(in4->sin_addr, dest);
+                *dest++ = ':';
+                return impl::formatDecimal(port(), dest);
+            }
+            if (auto in6 = asIPv6()) {
+                *dest++ = '[';
+                dest = formatIPv6Address(in6->sin6_addr, dest);
+                if (in6->sin6_scope_id) {
+                    *dest++ = '%';
+                    dest = impl::formatDecimal(in6->sin6_scope_id, dest);
+                }
+                *dest++ = ']';
+                *dest++ = ':';
+                return impl::formatDecimal(port(), dest);
+            }
+            #ifndef _WIN32
+            if (family() == AF_UNIX) {
+                if (isAbstract())
+                    *dest++ = '@';
+                auto path = unixPath();
+                memcpy(dest, path.data(), path.size());
+                return dest + path.size();
+            }
+            #endif
+            constexpr std::string_view unknown = "<family ";
+            memcpy(dest, unknown.data(), unknown.size());
+            dest = impl::formatDecimal(uint32_t(family()), dest + unknown.size());
+            *dest++ = '>';
+            return dest;
+        }
+
+        auto toString() const -> std::string {
+            char buf[maxTextLength];
+            return std::string(buf, formatTo(buf));
+        }
+
+        auto data() const noexcept -> const sockaddr * 
+            { return reinterpret_cast<const sockaddr *>(&m_storage); }
+        auto data() noexcept -> sockaddr * 
+            { return reinterpret_cast<sockaddr *>(&m_storage); }
+        constexpr auto length() const noexcept -> socklen_t 
+            { return m_length; }
+        
+        //for use after a raw call filled data() 
+        void setLength(socklen_t length) {
+            if (size_t(length) > size_t(capacity))
+                throwErrorCode(EINVAL, "socket address length {} exceeds maximum supported {}", length, capacity);
+            m_length = length;
+        }
+
+        auto family() const noexcept -> int {
+            if (size_t(m_length) < offsetof(sockaddr, sa_family) + sizeof(data()->sa_family))
+                return AF_UNSPEC;
+            return data()->sa_family;
+        }
+
+        explicit operator bool() const noexcept 
+            { return family() != AF_UNSPEC; }
+
+        auto asIPv4() const noexcept -> const sockaddr_in * 
+            { return family() == AF_INET && size_t(m_length) >= sizeof(sockaddr_in) ? &m_storage.in4 : nullptr; }
+        auto asIPv6() const noexcept -> const sockaddr_in6 * 
+            { return family() == AF_INET6 && size_t(m_length) >= sizeof(sockaddr_in6) ? &m_storage.in6 : nullptr; }
+        #ifndef _WIN32
+        auto asUnix() const noexcept -> const sockaddr_un * 
+            { return family() == AF_UNIX ? &m_storage.un : nullptr; }
+        #endif
+
+        //host byte order, 0 for non-IP addresses
+        auto port() const noexcept -> uint16_t {
+            if (auto in4 = asIPv4())
+                return impl::netToHost(uint16_t(in4->sin_port));
+            if (auto in6 = asIPv6())
+                return impl::netToHost(uint16_t(in6->sin6_port));
+            return 0;
+        }
+
+        auto scopeId() const noexcept -> uint32_t {
+            if (auto in6 = asIPv6())
+                return in6->sin6_scope_id;
+            return 0;
+        }
+
+        #ifndef _WIN32
+        //Unix path or abstract name without the leading NUL. Empty for unnamed and non-Unix addresses.
+        auto unixPath() const noexcept -> std::string_view {
+            auto un = asUnix();
+            if (!un)
+                return {};
+            size_t size = size_t(m_length) - offsetof(sockaddr_un, sun_path);
+            if (size == 0)
+                return {};
+            if (un->sun_path[0] == 0)
+                return {un->sun_path + 1, size - 1};
+            return {un->sun_path, strnlen(un->sun_path, size)};
+        }
+
+        auto isAbstract() const noexcept -> bool {
+            auto un = asUnix();
+            return un && size_t(m_length) > offsetof(sockaddr_un, sun_path) && un->sun_path[0] == 0;
+        }
+        #endif
+
+        friend auto operator==(const SocketAddress & lhs, const SocketAddress & rhs) noexcept -> bool {
+            int family = lhs.family();
+            if (family != rhs.family())
+                return false;
+            if (auto l4 = lhs.asIPv4()) {
+                auto r4 = rhs.asIPv4();
+                return r4 && l4->sin_port == r4->sin_port && l4->sin_addr.s_addr == r4->sin_addr.s_addr;
+            }
+            if (auto l6 = lhs.asIPv6()) {
+                auto r6 = rhs.asIPv6();
+                return r6 && l6->sin6_port == r6->sin6_port && l6->sin6_scope_id == r6->sin6_scope_id &&
+                       memcmp(&l6->sin6_addr, &r6->sin6_addr, sizeof(l6->sin6_addr)) == 0;
+            }
+            #ifndef _WIN32
+            if (family == AF_UNIX)
+                return lhs.isAbstract() == rhs.isAbstract() && lhs.unixPath() == rhs.unixPath();
+            #endif
+            return lhs.m_length == rhs.m_length && memcmp(&lhs.m_storage, &rhs.m_storage, size_t(lhs.m_length)) == 0;
+        }
+
+        //consistent with operator==: only the significant fields participate
+        auto hash() const noexcept -> size_t {
+            uint64_t ret = 14695981039346656037ull;
+            auto mix = [&ret](const void * bytes, size_t size) {
+                for (size_t i = 0; i < size; ++i) {
+                    ret ^= static_cast<const uint8_t *>(bytes)[i];
+                    ret *= 1099511628211ull;
+                }
+            };
+            int fam = family();
+            mix(&fam, sizeof(fam));
+            if (auto in4 = asIPv4()) {
+                mix(&in4->sin_port, sizeof(in4->sin_port));
+                mix(&in4->sin_addr, sizeof(in4->sin_addr));
+            } else if (auto in6 = asIPv6()) {
+                mix(&in6->sin6_port, sizeof(in6->sin6_port));
+                mix(&in6->sin6_addr, sizeof(in6->sin6_addr));
+                mix(&in6->sin6_scope_id, sizeof(in6->sin6_scope_id));
+            } 
+            #ifndef _WIN32
+            else if (fam == AF_UNIX) {
+                bool abstract = isAbstract();
+                auto path = unixPath();
+                mix(&abstract, sizeof(abstract));
+                mix(path.data(), path.size());
+            } 
+            #endif
+            else {
+                mix(&m_storage, size_t(m_length));
+            }
+            return size_t(ret);
+        }
+    private:
+        static constexpr auto parseIPv6WithScope(std::string_view text, uint16_t port) noexcept -> std::optional<SocketAddress> {
+            uint32_t scopeId = 0;
+            if (auto percent = text.find('%'); percent != text.npos) {
+                auto scope = text.substr(percent + 1);
+                if (scope.empty() || scope.size() > 10)
+                    return std::nullopt;
+                uint64_t val = 0;
+                for (char c: scope) {
+                    unsigned digit = impl::decimalDigit(c);
+                    if (digit > 9)
+                        return std::nullopt;
+                    val = val * 10 + digit;
+                }
+                if (val > std::numeric_limits<uint32_t>::max())
+                    return std::nullopt;
+                scopeId = uint32_t(val);
+                text = text.substr(0, percent);
+            }
+            std::array<uint8_t, 16> addr{};
+            if (!impl::parseIPv6Text(text, addr))
+                return std::nullopt;
+            return ipv6(addr, port, scopeId);
+        }
+    private:
+        Storage m_storage;
+        socklen_t m_length = 0;
+    };
+
     inline auto createSocket(int domain, int type, int protocol,
                              PTL_ERROR_REF_ARG(err)) -> Socket 
     requires(PTL_ERROR_REQ(err)) {
@@ -153,6 +756,27 @@ namespace ptl::inline v0 {
         return ret;
     }
 
+    #ifndef _WIN32
+    struct SocketPair {
+        static auto create(int domain, int type, int protocol,
+                           PTL_ERROR_REF_ARG(err)) -> SocketPair 
+        requires(PTL_ERROR_REQ(err)) {
+            int fds[2];
+            if (::socketpair(domain, type, protocol, fds) != 0) {
+                fds[0] = -1;
+                fds[1] = -1;
+                handleError(PTL_ERROR_REF(err), impl::getSocketError(), "socketpair({}, {}, {}) failed", domain, type, protocol);
+            } else {
+                clearError(PTL_ERROR_REF(err));
+            }
+            return SocketPair{Socket(fds[0]), Socket(fds[1])};
+        }
+
+        Socket first;
+        Socket second;
+    };
+    #endif
+
     inline void bindSocket(SocketLike auto && socket, const sockaddr * address, socklen_t address_len,
                            PTL_ERROR_REF_ARG(err))
     requires(PTL_ERROR_REQ(err)) {
@@ -164,6 +788,17 @@ namespace ptl::inline v0 {
             clearError(PTL_ERROR_REF(err));
     }
 
+    inline void bindSocket(SocketLike auto && socket, const SocketAddress & address,
+                           PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::bind(fd, address.data(), address.length());
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "bind({}, {}) failed", fd, address);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
     inline void getSocketName(SocketLike auto && socket, sockaddr * address, socklen_t * address_len,
                               PTL_ERROR_REF_ARG(err))
     requires(PTL_ERROR_REQ(err)) {
@@ -175,6 +810,213 @@ namespace ptl::inline v0 {
             clearError(PTL_ERROR_REF(err));
     }
 
+    inline auto getSocketName(SocketLike auto && socket,
+                              PTL_ERROR_REF_ARG(err)) -> SocketAddress
+    requires(PTL_ERROR_REQ(err)) {
+        SocketAddress ret;
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        socklen_t len = SocketAddress::capacity;
+        int res = ::getsockname(fd, ret.data(), &len);
+        if (res != 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "getsockname({}) failed", fd);
+        } else {
+            ret.setLength(len);
+            clearError(PTL_ERROR_REF(err));
+        }
+        return ret;
+    }
+
+    inline void listenSocket(SocketLike auto && socket, int backlog,
+                             PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::listen(fd, backlog);
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "listen({}, {}) failed", fd, backlog);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
+    namespace impl {
+        #ifndef _WIN32
+            #if PTL_HAVE_ACCEPT4
+                using ::accept4;
+            #else
+                inline int accept4(int fd, sockaddr * address, socklen_t * address_len, int flags) {
+                    int ret = ::accept(fd, address, address_len);
+                    if (ret < 0)
+                        return ret;
+                    //not atomic but the best we can do
+                    #ifdef SOCK_CLOEXEC
+                    if (flags & SOCK_CLOEXEC)
+                        ::fcntl(ret, F_SETFD, ::fcntl(ret, F_GETFD) | FD_CLOEXEC);
+                    #endif
+                    #ifdef SOCK_NONBLOCK
+                    if (flags & SOCK_NONBLOCK)
+                        ::fcntl(ret, F_SETFL, ::fcntl(ret, F_GETFL) | O_NONBLOCK);
+                    #endif
+                    (void)flags;
+                    return ret;
+                }
+            #endif
+        #else
+            inline SOCKET accept4(SOCKET fd, sockaddr * address, socklen_t * address_len, [[maybe_unused]] int flags) {
+                assert(flags == 0);
+                return ::accept(fd, address, address_len);
+            }
+        #endif
+    }
+
+    inline auto acceptSocket(SocketLike auto && socket, sockaddr * address, socklen_t * address_len, int flags,
+                             PTL_ERROR_REF_ARG(err)) -> Socket 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        Socket ret(impl::accept4(fd, address, address_len, flags));
+        if (!ret)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "accept4({}, {}) failed", fd, flags);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto acceptSocket(SocketLike auto && socket, SocketAddress & address, int flags,
+                             PTL_ERROR_REF_ARG(err)) -> Socket 
+    requires(PTL_ERROR_REQ(err)) {
+        socklen_t len = SocketAddress::capacity;
+        auto ret = acceptSocket(std::forward<decltype(socket)>(socket), address.data(), &len, flags, PTL_ERROR_REF(err));
+        address.setLength(ret ? len : 0);
+        return ret;
+    }
+
+    inline auto acceptSocket(SocketLike auto && socket, int flags,
+                             PTL_ERROR_REF_ARG(err)) -> Socket 
+    requires(PTL_ERROR_REQ(err)) {
+        return acceptSocket(std::forward<decltype(socket)>(socket), nullptr, nullptr, flags, PTL_ERROR_REF(err));
+    }
+
+    #ifndef _WIN32
+    inline auto acceptSocketBatch(SocketLike auto && socket, std::span<Socket> accepted, int flags,
+                                  PTL_ERROR_REF_ARG(err)) -> size_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        size_t count = 0;
+        clearError(PTL_ERROR_REF(err));
+        while (count < accepted.size()) {
+            int res = impl::accept4(fd, nullptr, nullptr, flags);
+            if (res < 0) {
+                int code = errno;
+                if (code == EINTR || code == ECONNABORTED)
+                    continue;
+                //an empty backlog is the normal way for the batch to end
+                if (code != EAGAIN && code != EWOULDBLOCK && count == 0)
+                    handleError(PTL_ERROR_REF(err), code, "accept4({}, {}) failed", fd, flags);
+                break;
+            }
+            accepted[count++] = Socket(res);
+        }
+        return count;
+    }
+    #endif
+
+    inline void connectSocket(SocketLike auto && socket, const sockaddr * address, socklen_t address_len,
+                              PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::connect(fd, address, address_len);
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "connect({}) failed", fd);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
+    inline void connectSocket(SocketLike auto && socket, const SocketAddress & address,
+                              PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::connect(fd, address.data(), address.length());
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "connect({}, {}) failed", fd, address);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
+    #ifndef _WIN32
+    namespace impl {
+        inline auto connectWithTimeout(int fd, const sockaddr * address, socklen_t address_len, 
+                                       std::chrono::milliseconds timeout) -> int {
+            int fileFlags = ::fcntl(fd, F_GETFL);
+            if (fileFlags < 0)
+                return errno;
+            const bool wasBlocking = (fileFlags & O_NONBLOCK) == 0;
+            if (wasBlocking && ::fcntl(fd, F_SETFL, fileFlags | O_NONBLOCK) != 0)
+                return errno;
+            
+            int code = 0;
+            if (::connect(fd, address, address_len) != 0) {
+                code = errno;
+                if (code == EINPROGRESS || code == EINTR) {
+                    const auto deadline = std::chrono::steady_clock::now() + timeout;
+                    for ( ; ; ) {
+                        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                        if (remaining.count() < 0)
+                            remaining = std::chrono::milliseconds(0);
+                        pollfd pfd{fd, POLLOUT, 0};
+                        int res = ::poll(&pfd, 1, int(std::min(remaining.count(), decltype(remaining.count())(std::numeric_limits<int>::max()))));
+                        if (res < 0) {
+                            if (errno == EINTR)
+                                continue;
+                            code = errno;
+                        } else if (res == 0) {
+                            code = ETIMEDOUT;
+                        } else {
+                            socklen_t len = sizeof(code);
+                            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &code, &len) != 0)
+                                code = errno;
+                        }
+                        break;
+                    }
+                }
+            }
+            if (wasBlocking)
+                ::fcntl(fd, F_SETFL, fileFlags);
+            return code;
+        }
+    }
+
+    inline void connectSocket(SocketLike auto && socket, const sockaddr * address, socklen_t address_len,
+                              std::chrono::milliseconds timeout,
+                              PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        if (int code = impl::connectWithTimeout(fd, address, address_len, timeout); code != 0)
+            handleError(PTL_ERROR_REF(err), code, "connect({}) failed", fd);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
+    inline void connectSocket(SocketLike auto && socket, const SocketAddress & address,
+                              std::chrono::milliseconds timeout,
+                              PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        if (int code = impl::connectWithTimeout(fd, address.data(), address.length(), timeout); code != 0)
+            handleError(PTL_ERROR_REF(err), code, "connect({}, {}) failed", fd, address);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+    #endif
+
+    inline void shutdownSocket(SocketLike auto && socket, int how,
+                               PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::shutdown(fd, how);
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "shutdown({}, {}) failed", fd, how);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
     inline auto receiveSocket(SocketLike auto && socket, void * buf, io_size_t length, int flags,
                               PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
     requires(PTL_ERROR_REQ(err)) {
@@ -211,6 +1053,16 @@ namespace ptl::inline v0 {
         return ret;
     }
 
+    inline auto receiveSocket(SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                              SocketAddress & address,
+                              PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        socklen_t len = SocketAddress::capacity;
+        auto ret = receiveSocket(std::forward<decltype(socket)>(socket), buf, length, flags, address.data(), &len, PTL_ERROR_REF(err));
+        address.setLength(ret >= 0 ? len : 0);
+        return ret;
+    }
+
     #ifndef _WIN32
     inline auto receiveSocket(SocketLike auto && socket, msghdr * message, int flags,
                               PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
@@ -262,6 +1114,13 @@ namespace ptl::inline v0 {
         return ret;
     }
 
+    inline auto sendSocket(SocketLike auto && socket, const void * buf, io_size_t length, int flags,
+                           const SocketAddress & dest,
+                           PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        return sendSocket(std::forward<decltype(socket)>(socket), buf, length, flags, dest.data(), dest.length(), PTL_ERROR_REF(err));
+    }
+
     #ifndef _WIN32
     inline auto sendSocket(SocketLike auto && socket, const msghdr * message, int flags,
                            PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
@@ -276,24 +1135,1378 @@ namespace ptl::inline v0 {
     }
     #endif
 
-    inline void setSocketOption(SocketLike auto && socket, 
-                                int level, int option_name, const void * option_value, socklen_t option_len,
-                                PTL_ERROR_REF_ARG(err)) 
+    #ifndef _WIN32
+
+    namespace impl {
+        inline auto sendAll(int fd, const void * buf, size_t length, int flags, TransferDeadline deadline, int & code) -> size_t {
+            auto start = static_cast<const std::byte *>(buf);
+            size_t done = 0;
+            return transferLoop(fd, POLLOUT, length, deadline, [&]() {
+                auto res = ::send(fd, start + done, length - done, flags);
+                if (res > 0)
+                    done += size_t(res);
+                return res;
+            }, code);
+        }
+
+        inline auto receiveExact(int fd, void * buf, size_t length, int flags, TransferDeadline deadline, int & code) -> size_t {
+            auto start = static_cast<std::byte *>(buf);
+            size_t done = 0;
+            return transferLoop(fd, POLLIN, length, deadline, [&]() {
+                auto res = ::recv(fd, start + done, length - done, flags);
+                if (res > 0)
+                    done += size_t(res);
+                return res;
+            }, code);
+        }
+
+        inline auto sendAll(int fd, std::span<const ::iovec> iov, int flags, TransferDeadline deadline, int & code) -> size_t {
+            IoVecCursor cursor(iov);
+            return transferLoop(fd, POLLOUT, cursor.total(), deadline, [&]() {
+                ssize_t res;
+                if (cursor.partial()) {
+                    auto [ptr, size] = cursor.current();
+                    res = ::send(fd, ptr, size, flags);
+                } else {
+                    auto rest = cursor.remaining();
+                    msghdr message{};
+                    message.msg_iov = const_cast<::iovec *>(rest.data());
+                    message.msg_iovlen = decltype(message.msg_iovlen)(rest.size());
+                    res = ::sendmsg(fd, &message, flags);
+                }
+                if (res > 0)
+                    cursor.advance(size_t(res));
+                return res;
+            }, code);
+        }
+
+        inline auto receiveExact(int fd, std::span<const ::iovec> iov, int flags, TransferDeadline deadline, int & code) -> size_t {
+            IoVecCursor cursor(iov);
+            return transferLoop(fd, POLLIN, cursor.total(), deadline, [&]() {
+                ssize_t res;
+                if (cursor.partial()) {
+                    auto [ptr, size] = cursor.current();
+                    res = ::recv(fd, ptr, size, flags);
+                } else {
+                    auto rest = cursor.remaining();
+                    msghdr message{};
+                    message.msg_iov = const_cast<::iovec *>(rest.data());
+                    message.msg_iovlen = decltype(message.msg_iovlen)(rest.size());
+                    res = ::recvmsg(fd, &message, flags);
+                }
+                if (res > 0)
+                    cursor.advance(size_t(res));
+                return res;
+            }, code);
+        }
+    }
+
+    //Sends all length bytes retrying short sends and EINTR. On a non-blocking socket waits for it 
+    //to become writable. Returns the number of bytes sent which is less than length only on error.
+    inline auto sendAll(SocketLike auto && socket, const void * buf, size_t length, int flags,
+                        PTL_ERROR_REF_ARG(err)) -> size_t
     requires(PTL_ERROR_REQ(err)) {
         auto fd = c_socket(std::forward<decltype(socket)>(socket));
-        int res = ::setsockopt(fd, level, option_name, static_cast<const impl::SocketOptionValueType *>(option_value), option_len);
-        if (res != 0)
-            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "setsockopt({}, {}, {}) failed", fd, level, option_name);
+        int code;
+        auto ret = impl::sendAll(fd, buf, length, flags, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "sendAll({}, ,{}) failed after {} bytes", fd, length, ret);
         else
             clearError(PTL_ERROR_REF(err));
+        return ret;
     }
 
-    inline void getSocketOption(SocketLike auto && socket, 
-                                int level, int option_name, void * option_value, socklen_t * option_len,
-                                PTL_ERROR_REF_ARG(err)) 
+    //Same as above but fails with ETIMEDOUT if waiting for readiness extends past the deadline
+    inline auto sendAll(SocketLike auto && socket, const void * buf, size_t length, int flags,
+                        std::chrono::steady_clock::time_point deadline,
+                        PTL_ERROR_REF_ARG(err)) -> size_t
     requires(PTL_ERROR_REQ(err)) {
         auto fd = c_socket(std::forward<decltype(socket)>(socket));
-        int res = ::getsockopt(fd, level, option_name, static_cast<impl::SocketOptionValueType *>(option_value), option_len);
+        int code;
+        auto ret = impl::sendAll(fd, buf, length, flags, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "sendAll({}, ,{}) failed after {} bytes", fd, length, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto sendAll(SocketLike auto && socket, std::span<const ::iovec> iov, int flags,
+                        PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::sendAll(fd, iov, flags, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "sendAll({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto sendAll(SocketLike auto && socket, std::span<const ::iovec> iov, int flags,
+                        std::chrono::steady_clock::time_point deadline,
+                        PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::sendAll(fd, iov, flags, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "sendAll({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    //Receives exactly length bytes retrying short receives and EINTR. On a non-blocking socket waits for it
+    //to become readable. Returns the number of bytes received which is less than length on error or 
+    //orderly shutdown by the peer. The shutdown is not an error.
+    inline auto receiveExact(SocketLike auto && socket, void * buf, size_t length, int flags,
+                             PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::receiveExact(fd, buf, length, flags, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "receiveExact({}, ,{}) failed after {} bytes", fd, length, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto receiveExact(SocketLike auto && socket, void * buf, size_t length, int flags,
+                             std::chrono::steady_clock::time_point deadline,
+                             PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::receiveExact(fd, buf, length, flags, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "receiveExact({}, ,{}) failed after {} bytes", fd, length, ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto receiveExact(SocketLike auto && socket, std::span<const ::iovec> iov, int flags,
+                             PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::receiveExact(fd, iov, flags, std::nullopt, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "receiveExact({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto receiveExact(SocketLike auto && socket, std::span<const ::iovec> iov, int flags,
+                             std::chrono::steady_clock::time_point deadline,
+                             PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int code;
+        auto ret = impl::receiveExact(fd, iov, flags, deadline, code);
+        if (code)
+            handleError(PTL_ERROR_REF(err), code, "receiveExact({}, [{}]) failed after {} bytes", fd, iov.size(), ret);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    #endif
+
+    #ifdef __linux__
+    //Size of the next datagram without consuming it. Waits for one unless the socket is non-blocking
+    //or flags include MSG_DONTWAIT.
+    inline auto getNextDatagramSize(SocketLike auto && socket, int flags,
+                                    PTL_ERROR_REF_ARG(err)) -> io_ssize_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto ret = ::recv(fd, nullptr, 0, flags | MSG_PEEK | MSG_TRUNC);
+        if (ret < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recv({}, MSG_PEEK | MSG_TRUNC) failed", fd);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+    #endif
+
+    //Bytes available for reading. For datagram sockets on Linux this is the size of the next 
+    //datagram, elsewhere usually the total of all queued ones.
+    inline auto getReceiveQueueSize(SocketLike auto && socket,
+                                    PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        #ifndef _WIN32
+            int value = 0;
+            int res = ::ioctl(fd, FIONREAD, &value);
+        #else
+            u_long value = 0;
+            int res = ::ioctlsocket(fd, FIONREAD, &value);
+        #endif
+        if (res != 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "ioctl({}, FIONREAD) failed", fd);
+            return 0;
+        }
+        clearError(PTL_ERROR_REF(err));
+        return size_t(value);
+    }
+
+    #if defined(SIOCOUTQ) || defined(SO_NWRITE)
+    //Bytes in the send queue. For TCP this includes sent but not yet acknowledged data.
+    inline auto getSendQueueSize(SocketLike auto && socket,
+                                 PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        #ifdef SIOCOUTQ
+            int value = 0;
+            if (::ioctl(fd, SIOCOUTQ, &value) != 0) {
+                handleError(PTL_ERROR_REF(err), impl::getSocketError(), "ioctl({}, SIOCOUTQ) failed", fd);
+                return 0;
+            }
+            clearError(PTL_ERROR_REF(err));
+            return size_t(value);
+        #else
+            socklen_t value = 0;
+            socklen_t len = sizeof(value);
+            if (::getsockopt(fd, SOL_SOCKET, SO_NWRITE, &value, &len) != 0) {
+                handleError(PTL_ERROR_REF(err), impl::getSocketError(), "getsockopt({}, SO_NWRITE) failed", fd);
+                return 0;
+            }
+            clearError(PTL_ERROR_REF(err));
+            return size_t(value);
+        #endif
+    }
+    #endif
+
+    #ifdef SIOCOUTQNSD
+    //Bytes in the TCP send queue that have not been sent yet
+    inline auto getUnsentSize(SocketLike auto && socket,
+                              PTL_ERROR_REF_ARG(err)) -> size_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int value = 0;
+        if (::ioctl(fd, SIOCOUTQNSD, &value) != 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "ioctl({}, SIOCOUTQNSD) failed", fd);
+            return 0;
+        }
+        clearError(PTL_ERROR_REF(err));
+        return size_t(value);
+    }
+    #endif
+
+    #ifndef _WIN32
+
+    //space needed in a control buffer for messages carrying the given payload types
+    template<class... T>
+    constexpr size_t ControlMessageSpace = (size_t(CMSG_SPACE(sizeof(T))) + ... + 0);
+
+    class ControlMessage {
+    public:
+        ControlMessage(const cmsghdr * header, std::span<const std::byte> data) noexcept :
+            m_header(header), m_data(data)
+        {}
+
+        auto level() const noexcept -> int
+            { return m_header->cmsg_level; }
+        auto type() const noexcept -> int
+            { return m_header->cmsg_type; }
+        auto is(int level, int type) const noexcept -> bool
+            { return m_header->cmsg_level == level && m_header->cmsg_type == type; }
+        auto header() const noexcept -> const cmsghdr *
+            { return m_header; }
+        auto data() const noexcept -> std::span<const std::byte>
+            { return m_data; }
+
+        //number of whole T values in the payload
+        template<class T>
+        auto count() const noexcept -> size_t
+            { return m_data.size() / sizeof(T); }
+
+        //payload is not necessarily aligned for T so it is always copied out
+        template<class T>
+        requires(std::is_trivially_copyable_v<T>)
+        auto as(size_t index = 0) const noexcept -> std::optional<T> {
+            if (index >= count<T>())
+                return std::nullopt;
+            T ret;
+            memcpy(&ret, m_data.data() + index * sizeof(T), sizeof(T));
+            return ret;
+        }
+    private:
+        const cmsghdr * m_header;
+        std::span<const std::byte> m_data;
+    };
+
+    class ControlMessages {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = ControlMessage;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            iterator() noexcept = default;
+            iterator(const std::byte * current, const std::byte * end) noexcept :
+                m_current(current), m_end(end) {
+                validate();
+            }
+
+            auto operator*() const noexcept -> value_type {
+                auto header = reinterpret_cast<const cmsghdr *>(m_current);
+                auto dataStart = m_current + CMSG_LEN(0);
+                auto dataSize = std::min(size_t(header->cmsg_len), size_t(m_end - m_current)) - size_t(CMSG_LEN(0));
+                return {header, {dataStart, dataSize}};
+            }
+            auto operator++() noexcept -> iterator & {
+                auto header = reinterpret_cast<const cmsghdr *>(m_current);
+                auto space = size_t(CMSG_SPACE(size_t(header->cmsg_len) - size_t(CMSG_LEN(0))));
+                m_current += std::min(space, size_t(m_end - m_current));
+                validate();
+                return *this;
+            }
+            auto operator++(int) noexcept -> iterator {
+                auto ret = *this;
+                ++*this;
+                return ret;
+            }
+            friend bool operator==(const iterator & lhs, const iterator & rhs) noexcept 
+                { return lhs.m_current == rhs.m_current; }
+        private:
+            //a header that does not fit or claims to be smaller than itself ends the sequence
+            void validate() noexcept {
+                auto remaining = size_t(m_end - m_current);
+                if (remaining < size_t(CMSG_LEN(0)) || 
+                    size_t(reinterpret_cast<const cmsghdr *>(m_current)->cmsg_len) < size_t(CMSG_LEN(0)))
+                    m_current = m_end;
+            }
+        private:
+            const std::byte * m_current = nullptr;
+            const std::byte * m_end = nullptr;
+        };
+
+        ControlMessages() noexcept = default;
+        //data must be aligned as cmsghdr, as any msg_control buffer is
+        ControlMessages(const void * data, size_t size) noexcept :
+            m_data(static_cast<const std::byte *>(data)), m_size(data ? size : 0) {
+            assert(reinterpret_cast<uintptr_t>(data) % alignof(cmsghdr) == 0);
+        }
+        explicit ControlMessages(const msghdr & message) noexcept :
+            ControlMessages(message.msg_control, size_t(message.msg_controllen))
+        {}
+
+        auto begin() const noexcept -> iterator
+            { return {m_data, m_data + m_size}; }
+        auto end() const noexcept -> iterator
+            { return {m_data + m_size, m_data + m_size}; }
+        auto empty() const noexcept -> bool
+            { return begin() == end(); }
+
+        auto find(int level, int type) const noexcept -> std::optional<ControlMessage> {
+            for (auto message: *this) {
+                if (message.is(level, type))
+                    return message;
+            }
+            return std::nullopt;
+        }
+    private:
+        const std::byte * m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    template<size_t IovCount, size_t ControlSize = 0>
+    class MessageHeader {
+        static_assert(IovCount > 0, "MessageHeader must have room for at least one buffer");
+    public:
+        static constexpr size_t iovCapacity = IovCount;
+        static constexpr size_t controlCapacity = ControlSize;
+
+        MessageHeader() noexcept 
+            { m_header.msg_iov = m_iov; }
+        //the header points into the object itself
+        MessageHeader(const MessageHeader &) = delete;
+        MessageHeader & operator=(const MessageHeader &) = delete;
+
+        auto payload(const void * buf, size_t size) -> MessageHeader & {
+            if (m_iovCount == IovCount)
+                throwErrorCode(EINVAL, "MessageHeader can hold at most {} buffers", IovCount);
+            m_iov[m_iovCount++] = {const_cast<void *>(buf), size};
+            m_header.msg_iovlen = decltype(m_header.msg_iovlen)(m_iovCount);
+            return *this;
+        }
+        template<class T, size_t Extent>
+        auto payload(std::span<T, Extent> data) -> MessageHeader & 
+            { return payload(data.data(), data.size_bytes()); }
+
+        auto address(const SocketAddress & addr) noexcept -> MessageHeader & {
+            m_address = addr;
+            m_header.msg_name = m_address.data();
+            m_header.msg_namelen = m_address.length();
+            return *this;
+        }
+        auto address(const sockaddr * addr, socklen_t addrLen) -> MessageHeader & 
+            { return address(SocketAddress(addr, addrLen)); }
+
+        auto control(int level, int type, const void * data, size_t size) -> MessageHeader & {
+            const size_t space = CMSG_SPACE(size);
+            if (space > ControlSize - m_controlSize)
+                throwErrorCode(EINVAL, "control message of {} bytes does not fit into remaining {} bytes of MessageHeader", 
+                               size, ControlSize - m_controlSize);
+            auto cmsg = reinterpret_cast<cmsghdr *>(m_control + m_controlSize);
+            memset(cmsg, 0, space);
+            cmsg->cmsg_level = level;
+            cmsg->cmsg_type = type;
+            cmsg->cmsg_len = decltype(cmsg->cmsg_len)(CMSG_LEN(size));
+            memcpy(CMSG_DATA(cmsg), data, size);
+            m_controlSize += space;
+            m_header.msg_control = m_control;
+            m_header.msg_controllen = decltype(m_header.msg_controllen)(m_controlSize);
+            return *this;
+        }
+        template<class T>
+        requires(std::is_trivially_copyable_v<T>)
+        auto control(int level, int type, const T & value) -> MessageHeader & 
+            { return control(level, type, &value, sizeof(T)); }
+        template<class T, size_t Extent>
+        requires(std::is_trivially_copyable_v<T>)
+        auto control(int level, int type, std::span<T, Extent> values) -> MessageHeader & 
+            { return control(level, type, values.data(), values.size_bytes()); }
+
+        //forgets payload, address and control messages
+        auto clear() noexcept -> MessageHeader & {
+            m_iovCount = 0;
+            m_controlSize = 0;
+            m_address = SocketAddress();
+            m_header = msghdr{};
+            m_header.msg_iov = m_iov;
+            return *this;
+        }
+
+        //make address and the whole control buffer available to recvmsg
+        auto prepareReceive() noexcept -> msghdr * {
+            m_address = SocketAddress();
+            m_header.msg_name = m_address.data();
+            m_header.msg_namelen = SocketAddress::capacity;
+            m_header.msg_control = ControlSize ? m_control : nullptr;
+            m_header.msg_controllen = decltype(m_header.msg_controllen)(ControlSize);
+            m_header.msg_flags = 0;
+            return &m_header;
+        }
+        //pick up what recvmsg filled in
+        void completeReceive(bool succeeded) noexcept {
+            m_address.setLength(succeeded ? std::min(m_header.msg_namelen, SocketAddress::capacity) : 0);
+            m_controlSize = succeeded ? std::min(size_t(m_header.msg_controllen), ControlSize) : 0;
+            m_header.msg_namelen = m_address.length();
+            m_header.msg_controllen = decltype(m_header.msg_controllen)(m_controlSize);
+            if (!m_controlSize)
+                m_header.msg_control = nullptr;
+        }
+
+        auto get() noexcept -> msghdr *
+            { return &m_header; }
+        auto get() const noexcept -> const msghdr *
+            { return &m_header; }
+        auto iov() const noexcept -> std::span<const iovec>
+            { return {m_iov, m_iovCount}; }
+        auto address() const noexcept -> const SocketAddress &
+            { return m_address; }
+        auto controlMessages() const noexcept -> ControlMessages
+            { return ControlMessages(m_control, m_controlSize); }
+        //msg_flags from the last receive
+        auto flags() const noexcept -> int
+            { return m_header.msg_flags; }
+        auto controlTruncated() const noexcept -> bool
+            { return m_header.msg_flags & MSG_CTRUNC; }
+    private:
+        msghdr m_header{};
+        iovec m_iov[IovCount];
+        size_t m_iovCount = 0;
+        size_t m_controlSize = 0;
+        SocketAddress m_address;
+        alignas(cmsghdr) std::byte m_control[ControlSize ? ControlSize : 1];
+    };
+
+    template<size_t IovCount, size_t ControlSize>
+    inline auto receiveSocket(SocketLike auto && socket, MessageHeader<IovCount, ControlSize> & message, int flags,
+                              PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto ret = receiveSocket(std::forward<decltype(socket)>(socket), message.prepareReceive(), flags, PTL_ERROR_REF(err));
+        message.completeReceive(ret >= 0);
+        return ret;
+    }
+
+    template<size_t IovCount, size_t ControlSize>
+    inline auto sendSocket(SocketLike auto && socket, const MessageHeader<IovCount, ControlSize> & message, int flags,
+                           PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        return sendSocket(std::forward<decltype(socket)>(socket), message.get(), flags, PTL_ERROR_REF(err));
+    }
+
+    #endif
+
+    #ifndef _WIN32
+
+    #if PTL_HAVE_RECVMMSG || PTL_HAVE_SENDMMSG
+        using MultiMessageHeader = ::mmsghdr;
+    #else
+        struct MultiMessageHeader {
+            msghdr msg_hdr;
+            unsigned msg_len;
+        };
+    #endif
+
+    #if defined(MSG_WAITFORONE)
+        constexpr int MsgWaitForOne = MSG_WAITFORONE;
+    #elif !PTL_HAVE_RECVMMSG
+        //only understood by PTL's own recvmmsg emulation
+        constexpr int MsgWaitForOne = 0x40000000;
+    #else
+        constexpr int MsgWaitForOne = 0;
+    #endif
+
+    namespace impl {
+        constexpr auto alignBatchSize(size_t size) noexcept -> size_t {
+            constexpr size_t alignment = alignof(std::max_align_t);
+            return (size + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    //A batch of message headers with their addresses, control buffers and data buffers.
+    //With bufferSize 0 the batch owns no data buffers and each one has to be attached via setBuffer()
+    class SocketBatch {
+    public:
+        SocketBatch(size_t capacity, size_t bufferSize, size_t controlSize = 0) :
+            m_capacity(capacity),
+            m_bufferSize(bufferSize),
+            m_controlSize(impl::alignBatchSize(controlSize)) {
+
+            const size_t headersSize = impl::alignBatchSize(capacity * sizeof(MultiMessageHeader));
+            const size_t iovecsSize = impl::alignBatchSize(capacity * sizeof(iovec));
+            const size_t addressesSize = impl::alignBatchSize(capacity * sizeof(sockaddr_storage));
+            const size_t slotsSize = impl::alignBatchSize(capacity * sizeof(std::span<std::byte>));
+            const size_t controlsSize = capacity * m_controlSize;
+            const size_t total = headersSize + iovecsSize + addressesSize + slotsSize + controlsSize + capacity * bufferSize;
+
+            m_block.reset(new std::max_align_t[(total + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+            auto start = reinterpret_cast<std::byte *>(m_block.get());
+            m_headers = reinterpret_cast<MultiMessageHeader *>(start);
+            m_iovecs = reinterpret_cast<iovec *>(start + headersSize);
+            m_addresses = reinterpret_cast<sockaddr_storage *>(start + headersSize + iovecsSize);
+            m_slots = reinterpret_cast<std::span<std::byte> *>(start + headersSize + iovecsSize + addressesSize);
+            m_controls = start + headersSize + iovecsSize + addressesSize + slotsSize;
+            auto buffers = m_controls + controlsSize;
+            
+            for (size_t i = 0; i < capacity; ++i) {
+                auto & hdr = m_headers[i].msg_hdr;
+                hdr = msghdr{};
+                hdr.msg_iov = &m_iovecs[i];
+                hdr.msg_iovlen = 1;
+                new (&m_slots[i]) std::span<std::byte>(buffers + i * bufferSize, bufferSize);
+                m_iovecs[i].iov_base = m_slots[i].data();
+            }
+            resetForReceive();
+        }
+        SocketBatch(const SocketBatch &) = delete;
+        //the moved-from batch is left empty with no capacity
+        SocketBatch(SocketBatch && src) noexcept :
+            m_block(std::move(src.m_block)),
+            m_capacity(std::exchange(src.m_capacity, 0)),
+            m_bufferSize(std::exchange(src.m_bufferSize, 0)),
+            m_controlSize(std::exchange(src.m_controlSize, 0)),
+            m_size(std::exchange(src.m_size, 0)),
+            m_headers(std::exchange(src.m_headers, nullptr)),
+            m_iovecs(std::exchange(src.m_iovecs, nullptr)),
+            m_addresses(std::exchange(src.m_addresses, nullptr)),
+            m_slots(std::exchange(src.m_slots, nullptr)),
+            m_controls(std::exchange(src.m_controls, nullptr))
+        {}
+        SocketBatch & operator=(SocketBatch src) noexcept {
+            swap(src, *this);
+            return *this;
+        }
+
+        friend void swap(SocketBatch & lhs, SocketBatch & rhs) noexcept {
+            std::swap(lhs.m_block, rhs.m_block);
+            std::swap(lhs.m_capacity, rhs.m_capacity);
+            std::swap(lhs.m_bufferSize, rhs.m_bufferSize);
+            std::swap(lhs.m_controlSize, rhs.m_controlSize);
+            std::swap(lhs.m_size, rhs.m_size);
+            std::swap(lhs.m_headers, rhs.m_headers);
+            std::swap(lhs.m_iovecs, rhs.m_iovecs);
+            std::swap(lhs.m_addresses, rhs.m_addresses);
+            std::swap(lhs.m_slots, rhs.m_slots);
+            std::swap(lhs.m_controls, rhs.m_controls);
+        }
+
+        auto capacity() const noexcept -> size_t
+            { return m_capacity; }
+        auto bufferSize() const noexcept -> size_t
+            { return m_bufferSize; }
+        auto controlSize() const noexcept -> size_t
+            { return m_controlSize; }
+        
+        //number of messages received or sent by the last batch call
+        auto size() const noexcept -> size_t
+            { return m_size; }
+
+        auto headers() noexcept -> MultiMessageHeader *
+            { return m_headers; }
+        auto headers() const noexcept -> const MultiMessageHeader *
+            { return m_headers; }
+
+        auto buffer(size_t idx) noexcept -> std::span<std::byte>
+            { return m_slots[idx]; }
+        auto data(size_t idx) const noexcept -> std::span<const std::byte>
+            { return m_slots[idx].first(std::min(size_t(m_headers[idx].msg_len), m_slots[idx].size())); }
+        auto length(size_t idx) const noexcept -> size_t
+            { return m_headers[idx].msg_len; }
+        auto messageFlags(size_t idx) const noexcept -> int
+            { return m_headers[idx].msg_hdr.msg_flags; }
+        auto address(size_t idx) noexcept -> sockaddr *
+            { return reinterpret_cast<sockaddr *>(&m_addresses[idx]); }
+        auto address(size_t idx) const noexcept -> const sockaddr *
+            { return reinterpret_cast<const sockaddr *>(&m_addresses[idx]); }
+        auto addressLength(size_t idx) const noexcept -> socklen_t
+            { return socklen_t(m_headers[idx].msg_hdr.msg_namelen); }
+        auto control(size_t idx) noexcept -> std::span<std::byte>
+            { return {m_controls + idx * m_controlSize, size_t(m_headers[idx].msg_hdr.msg_controllen)}; }
+
+        //Uses externally owned memory, such as a pooled buffer, as the data buffer for idx.
+        //The memory must stay valid while the batch refers to it.
+        void setBuffer(size_t idx, std::span<std::byte> buffer) noexcept {
+            m_slots[idx] = buffer;
+            m_iovecs[idx].iov_base = buffer.data();
+            m_iovecs[idx].iov_len = buffer.size();
+        }
+
+        void setMessage(size_t idx, size_t length) noexcept {
+            auto & hdr = m_headers[idx].msg_hdr;
+            m_iovecs[idx].iov_len = std::min(length, m_slots[idx].size());
+            hdr.msg_name = nullptr;
+            hdr.msg_namelen = 0;
+            hdr.msg_control = nullptr;
+            hdr.msg_controllen = 0;
+        }
+        void setMessage(size_t idx, size_t length, const sockaddr * address, socklen_t addressLength) noexcept {
+            setMessage(idx, length);
+            auto & hdr = m_headers[idx].msg_hdr;
+            addressLength = std::min(addressLength, socklen_t(sizeof(sockaddr_storage)));
+            memcpy(&m_addresses[idx], address, size_t(addressLength));
+            hdr.msg_name = &m_addresses[idx];
+            hdr.msg_namelen = addressLength;
+        }
+        void setControlLength(size_t idx, size_t length) noexcept {
+            auto & hdr = m_headers[idx].msg_hdr;
+            length = std::min(length, m_controlSize);
+            hdr.msg_control = length ? m_controls + idx * m_controlSize : nullptr;
+            hdr.msg_controllen = decltype(hdr.msg_controllen)(length);
+        }
+
+        void resetForReceive() noexcept {
+            for (size_t i = 0; i < m_capacity; ++i) {
+                auto & hdr = m_headers[i].msg_hdr;
+                m_iovecs[i].iov_len = m_slots[i].size();
+                hdr.msg_name = &m_addresses[i];
+                hdr.msg_namelen = socklen_t(sizeof(sockaddr_storage));
+                hdr.msg_control = m_controlSize ? m_controls + i * m_controlSize : nullptr;
+                hdr.msg_controllen = decltype(hdr.msg_controllen)(m_controlSize);
+                hdr.msg_flags = 0;
+                m_headers[i].msg_len = 0;
+            }
+            m_size = 0;
+        }
+
+        void setSize(size_t size) noexcept
+            { m_size = size; }
+    private:
+        std::unique_ptr<std::max_align_t[]> m_block;
+        size_t m_capacity;
+        size_t m_bufferSize;
+        size_t m_controlSize;
+        size_t m_size = 0;
+        MultiMessageHeader * m_headers = nullptr;
+        iovec * m_iovecs = nullptr;
+        sockaddr_storage * m_addresses = nullptr;
+        std::span<std::byte> * m_slots = nullptr;
+        std::byte * m_controls = nullptr;
+    };
+
+    namespace impl {
+        #if !PTL_HAVE_RECVMMSG
+        inline int recvmmsg(int fd, MultiMessageHeader * msgs, unsigned count, int flags, ::timespec * timeout) {
+            ::timespec deadline{};
+            if (timeout) {
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                deadline.tv_sec += timeout->tv_sec;
+                deadline.tv_nsec += timeout->tv_nsec;
+                if (deadline.tv_nsec >= 1'000'000'000) {
+                    deadline.tv_nsec -= 1'000'000'000;
+                    ++deadline.tv_sec;
+                }
+            }
+            const bool waitForOne = (flags & MsgWaitForOne) != 0;
+            flags &= ~MsgWaitForOne;
+            unsigned received = 0;
+            for ( ; received < count; ++received) {
+                int currentFlags = flags;
+                if (received > 0 && waitForOne)
+                    currentFlags |= MSG_DONTWAIT;
+                auto res = ::recvmsg(fd, &msgs[received].msg_hdr, currentFlags);
+                if (res < 0) {
+                    if (received > 0)
+                        break;
+                    return -1;
+                }
+                msgs[received].msg_len = unsigned(res);
+                //like the kernel, only check the timeout after each datagram
+                if (timeout) {
+                    ::timespec now;
+                    clock_gettime(CLOCK_MONOTONIC, &now);
+                    if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+                        ++received;
+                        break;
+                    }
+                }
+            }
+            return int(received);
+        }
+        #else
+            using ::recvmmsg;
+        #endif
+
+        #if !PTL_HAVE_SENDMMSG
+        inline int sendmmsg(int fd, MultiMessageHeader * msgs, unsigned count, int flags) {
+            unsigned sent = 0;
+            for ( ; sent < count; ++sent) {
+                auto res = ::sendmsg(fd, &msgs[sent].msg_hdr, flags);
+                if (res < 0) {
+                    if (sent > 0)
+                        break;
+                    return -1;
+                }
+                msgs[sent].msg_len = unsigned(res);
+            }
+            return int(sent);
+        }
+        #else
+            using ::sendmmsg;
+        #endif
+
+        inline auto receiveSocketBatch(int fd, SocketBatch & batch, size_t count, int flags, ::timespec * timeout) -> int {
+            batch.resetForReceive();
+            count = std::min(count, batch.capacity());
+            if constexpr (IsNumericallyBigger<size_t, unsigned>) {
+                count = std::min(count, size_t(std::numeric_limits<unsigned>::max()));
+            }
+            int res = impl::recvmmsg(fd, batch.headers(), unsigned(count), flags, timeout);
+            batch.setSize(res > 0 ? size_t(res) : 0);
+            return res;
+        }
+    }
+
+    inline auto receiveSocketBatch(SocketLike auto && socket, SocketBatch & batch, size_t count, int flags,
+                                   PTL_ERROR_REF_ARG(err)) -> size_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = impl::receiveSocketBatch(fd, batch, count, flags, nullptr);
+        if (res < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recvmmsg({}, ,{}) failed", fd, count);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return batch.size();
+    }
+
+    inline auto receiveSocketBatch(SocketLike auto && socket, SocketBatch & batch, int flags,
+                                   PTL_ERROR_REF_ARG(err)) -> size_t 
+    requires(PTL_ERROR_REQ(err)) {
+        return receiveSocketBatch(std::forward<decltype(socket)>(socket), batch, batch.capacity(), flags, PTL_ERROR_REF(err));
+    }
+
+    inline auto receiveSocketBatch(SocketLike auto && socket, SocketBatch & batch, size_t count, int flags,
+                                   std::chrono::nanoseconds timeout,
+                                   PTL_ERROR_REF_ARG(err)) -> size_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        ::timespec ts{};
+        ts.tv_sec = decltype(ts.tv_sec)(secs.count());
+        ts.tv_nsec = decltype(ts.tv_nsec)((timeout - secs).count());
+        int res = impl::receiveSocketBatch(fd, batch, count, flags, &ts);
+        if (res < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recvmmsg({}, ,{}) failed", fd, count);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return batch.size();
+    }
+
+    inline auto sendSocketBatch(SocketLike auto && socket, SocketBatch & batch, size_t count, int flags,
+                                PTL_ERROR_REF_ARG(err)) -> size_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        count = std::min(count, batch.capacity());
+        if constexpr (IsNumericallyBigger<size_t, unsigned>) {
+            count = std::min(count, size_t(std::numeric_limits<unsigned>::max()));
+        }
+        int res = impl::sendmmsg(fd, batch.headers(), unsigned(count), flags);
+        batch.setSize(res > 0 ? size_t(res) : 0);
+        if (res < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "sendmmsg({}, ,{}) failed", fd, count);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return batch.size();
+    }
+
+    #endif
+
+    #ifdef UDP_SEGMENT
+    namespace impl {
+        inline auto sendSocketSegmented(int fd, const void * buf, io_size_t length, uint16_t segmentSize, int flags,
+                                        const sockaddr * dest_addr, socklen_t dest_len) -> io_ssize_t {
+            iovec iov{const_cast<void *>(buf), length};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+            msghdr msg{};
+            msg.msg_name = const_cast<sockaddr *>(dest_addr);
+            msg.msg_namelen = dest_len;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            return ::sendmsg(fd, &msg, flags);
+        }
+    }
+
+    inline auto sendSocketSegmented(SocketLike auto && socket, const void * buf, io_size_t length, uint16_t segmentSize, int flags,
+                                    PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto ret = impl::sendSocketSegmented(fd, buf, length, segmentSize, flags, nullptr, 0);
+        if (ret < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "sendmsg({}, ,{}) with UDP_SEGMENT {} failed", fd, length, segmentSize);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto sendSocketSegmented(SocketLike auto && socket, const void * buf, io_size_t length, uint16_t segmentSize, int flags,
+                                    const sockaddr * dest_addr, socklen_t dest_len,
+                                    PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto ret = impl::sendSocketSegmented(fd, buf, length, segmentSize, flags, dest_addr, dest_len);
+        if (ret < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "sendmsg({}, ,{}) with UDP_SEGMENT {} failed", fd, length, segmentSize);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+    #endif
+
+    #ifdef UDP_GRO
+    class DatagramSegments {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::span<const std::byte>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            iterator() noexcept = default;
+            iterator(const std::byte * current, const std::byte * end, size_t segmentSize) noexcept :
+                m_current(current), m_end(end), m_segmentSize(segmentSize) 
+            {}
+
+            auto operator*() const noexcept -> value_type 
+                { return {m_current, std::min(m_segmentSize, size_t(m_end - m_current))}; }
+            auto operator++() noexcept -> iterator & {
+                m_current += std::min(m_segmentSize, size_t(m_end - m_current));
+                return *this;
+            }
+            auto operator++(int) noexcept -> iterator {
+                auto ret = *this;
+                ++*this;
+                return ret;
+            }
+            friend bool operator==(const iterator & lhs, const iterator & rhs) noexcept 
+                { return lhs.m_current == rhs.m_current; }
+        private:
+            const std::byte * m_current = nullptr;
+            const std::byte * m_end = nullptr;
+            size_t m_segmentSize = 0;
+        };
+
+        DatagramSegments() noexcept = default;
+        DatagramSegments(std::span<const std::byte> data, size_t segmentSize) noexcept :
+            DatagramSegments(data, segmentSize, data.size(), 0)
+        {}
+        DatagramSegments(std::span<const std::byte> data, size_t segmentSize, size_t length, int messageFlags) noexcept :
+            m_data(data), m_segmentSize(segmentSize ? segmentSize : data.size()), m_length(length), m_messageFlags(messageFlags)
+        {}
+
+        auto data() const noexcept -> std::span<const std::byte>
+            { return m_data; }
+        auto segmentSize() const noexcept -> size_t
+            { return m_segmentSize; }
+        //byte count returned by recvmsg. With MSG_TRUNC in the flags this is the full size even if it did not fit
+        auto length() const noexcept -> size_t
+            { return m_length; }
+        auto messageFlags() const noexcept -> int
+            { return m_messageFlags; }
+        //the buffer was too small and the last segment is cut short
+        auto truncated() const noexcept -> bool
+            { return (m_messageFlags & MSG_TRUNC) != 0; }
+        auto size() const noexcept -> size_t
+            { return m_segmentSize ? (m_data.size() + m_segmentSize - 1) / m_segmentSize : 0; }
+        auto empty() const noexcept -> bool
+            { return m_data.empty(); }
+        
+        auto begin() const noexcept -> iterator
+            { return {m_data.data(), m_data.data() + m_data.size(), m_segmentSize}; }
+        auto end() const noexcept -> iterator
+            { return {m_data.data() + m_data.size(), m_data.data() + m_data.size(), m_segmentSize}; }
+    private:
+        std::span<const std::byte> m_data;
+        size_t m_segmentSize = 0;
+        size_t m_length = 0;
+        int m_messageFlags = 0;
+    };
+
+    namespace impl {
+        //UDP_GRO arrives together with whatever else is enabled on the socket: timestamps, IP_PKTINFO, SO_RXQ_OVFL...
+        constexpr size_t CoalescedControlSize = 256;
+
+        //With the control data truncated the segment size may be lost. The data is still returned in segments 
+        //but the call fails with EMSGSIZE rather than pretending it is a single datagram.
+        inline auto receiveSocketCoalesced(int fd, void * buf, io_size_t length, int flags,
+                                           sockaddr * address, socklen_t * address_len,
+                                           DatagramSegments & segments) -> io_ssize_t {
+            iovec iov{buf, length};
+            alignas(cmsghdr) char control[CoalescedControlSize] = {};
+            msghdr msg{};
+            msg.msg_name = address;
+            msg.msg_namelen = address_len ? *address_len : 0;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            auto ret = ::recvmsg(fd, &msg, flags);
+            if (ret < 0) {
+                segments = DatagramSegments();
+                return ret;
+            }
+            if (address_len)
+                *address_len = msg.msg_namelen;
+            int segmentSize = 0;
+            bool found = false;
+            for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+                    found = true;
+                    break;
+                }
+            }
+            auto received = std::min(size_t(ret), size_t(length));
+            segments = DatagramSegments({static_cast<const std::byte *>(buf), received}, size_t(segmentSize > 0 ? segmentSize : 0),
+                                        size_t(ret), msg.msg_flags);
+            if (!found && (msg.msg_flags & MSG_CTRUNC)) {
+                errno = EMSGSIZE;
+                return -1;
+            }
+            return ret;
+        }
+    }
+
+    inline auto receiveSocketCoalesced(SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                                       PTL_ERROR_REF_ARG(err)) -> DatagramSegments 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        DatagramSegments ret;
+        if (impl::receiveSocketCoalesced(fd, buf, length, flags, nullptr, nullptr, ret) < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recvmsg({}, ,{}) failed", fd, length);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+
+    inline auto receiveSocketCoalesced(SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                                       sockaddr * address, socklen_t * address_len,
+                                       PTL_ERROR_REF_ARG(err)) -> DatagramSegments 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        DatagramSegments ret;
+        if (impl::receiveSocketCoalesced(fd, buf, length, flags, address, address_len, ret) < 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recvmsg({}, ,{}) failed", fd, length);
+        else
+            clearError(PTL_ERROR_REF(err));
+        return ret;
+    }
+    #endif
+
+    #if defined(MSG_ERRQUEUE) && defined(SO_EE_ORIGIN_LOCAL)
+    namespace impl {
+        //Whether an error queue entry is a genuine error rather than a notification such as 
+        //a zero-copy completion or a transmit timestamp (which comes with ENOMSG)
+        constexpr auto isErrorQueueFailure(const sock_extended_err & ee) noexcept -> bool {
+            return ee.ee_errno != 0 && 
+                   (ee.ee_origin == SO_EE_ORIGIN_LOCAL || ee.ee_origin == SO_EE_ORIGIN_ICMP || ee.ee_origin == SO_EE_ORIGIN_ICMP6);
+        }
+
+        //The single reader behind all the error queue functions. Reads entries until convert, called with the 
+        //extended error record and the message, returns a value. Entries it rejects are skipped unless they are 
+        //genuine errors, which are reported. Returns nullopt with no error when the queue is empty.
+        template<class Convert>
+        auto receiveErrorQueue(int fd, Convert convert, 
+                               PTL_ERROR_REF_ARG(err)) -> std::invoke_result_t<Convert, const sock_extended_err &, const msghdr &>
+        requires(PTL_ERROR_REQ(err)) {
+            //room for the extended error with the offender address plus SCM_TIMESTAMPING
+            alignas(cmsghdr) char control[256];
+            //without OptTsOnly the looped back packet is returned too. We don't need it.
+            char data[1];
+            for ( ; ; ) {
+                iovec iov{data, sizeof(data)};
+                msghdr msg{};
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                    if (int code = errno; code != EAGAIN && code != EWOULDBLOCK)
+                        handleError(PTL_ERROR_REF(err), code, "recvmsg({}, MSG_ERRQUEUE) failed", fd);
+                    else
+                        clearError(PTL_ERROR_REF(err));
+                    return std::nullopt;
+                }
+                for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                    if ((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                        (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                        sock_extended_err ee;
+                        memcpy(&ee, CMSG_DATA(cmsg), sizeof(ee));
+                        if (auto ret = convert(std::as_const(ee), std::as_const(msg))) {
+                            clearError(PTL_ERROR_REF(err));
+                            return ret;
+                        }
+                        //do not silently swallow genuine errors queued on the socket
+                        if (isErrorQueueFailure(ee)) {
+                            handleError(PTL_ERROR_REF(err), int(ee.ee_errno), "error queued on socket {}", fd);
+                            return std::nullopt;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    #endif
+
+    #if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    inline auto sendSocketZeroCopy(SocketLike auto && socket, const void * buf, io_size_t length, int flags, uint32_t & sequence,
+                                   PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto ret = ::send(fd, buf, length, flags | MSG_ZEROCOPY);
+        if (ret < 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "send({}, ,{}) with MSG_ZEROCOPY failed", fd, length);
+        } else {
+            //every successful MSG_ZEROCOPY send consumes one notification id
+            ++sequence;
+            clearError(PTL_ERROR_REF(err));
+        }
+        return ret;
+    }
+
+    inline auto sendSocketZeroCopy(SocketLike auto && socket, const void * buf, io_size_t length, int flags, uint32_t & sequence,
+                                   const sockaddr * dest_addr, socklen_t dest_len,
+                                   PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        auto ret = ::sendto(fd, buf, length, flags | MSG_ZEROCOPY, dest_addr, dest_len);
+        if (ret < 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "sendto({}, ,{}) with MSG_ZEROCOPY failed", fd, length);
+        } else {
+            ++sequence;
+            clearError(PTL_ERROR_REF(err));
+        }
+        return ret;
+    }
+
+    struct ZeroCopyCompletion {
+        uint32_t first;
+        uint32_t last;
+        bool copied;
+
+        auto contains(uint32_t id) const noexcept -> bool 
+            { return uint32_t(id - first) <= uint32_t(last - first); }
+        auto count() const noexcept -> uint32_t
+            { return last - first + 1; }
+    };
+
+    namespace impl {
+        inline auto makeZeroCopyCompletion(const sock_extended_err & ee) noexcept -> ZeroCopyCompletion
+            { return ZeroCopyCompletion{ee.ee_info, ee.ee_data, (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0}; }
+    }
+
+    //Retrieves the next zero-copy completion from the socket error queue.
+    //Returns nullopt with no error when the queue is empty. Other notifications, such as transmit timestamps,
+    //are skipped: use receiveErrorQueueNotification on sockets that use both.
+    inline auto receiveZeroCopyCompletion(SocketLike auto && socket,
+                                          PTL_ERROR_REF_ARG(err)) -> std::optional<ZeroCopyCompletion>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        return impl::receiveErrorQueue(fd, [](const sock_extended_err & ee, const msghdr &) -> std::optional<ZeroCopyCompletion> {
+            if (ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                return impl::makeZeroCopyCompletion(ee);
+            return std::nullopt;
+        }, PTL_ERROR_REF(err));
+    }
+    #endif
+
+    #ifdef MSG_DONTWAIT
+
+    //Counters maintained by receiveSocketSpinning. Accumulate over many calls to tune the spin budget.
+    struct SpinReceiveStats {
+        uint64_t spinHits = 0;          //data arrived while spinning
+        uint64_t blockingWaits = 0;     //spin budget exhausted, had to block
+        uint64_t spinIterations = 0;    //non-blocking receive attempts that found no data
+    };
+
+    //Receives using non-blocking calls for up to spinBudget before falling back to waiting in poll. 
+    //The socket itself may be blocking or not.
+    inline auto receiveSocketSpinning(SocketLike auto && socket, void * buf, io_size_t length, int flags,
+                                      std::chrono::nanoseconds spinBudget, SpinReceiveStats & stats,
+                                      PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        const auto deadline = std::chrono::steady_clock::now() + spinBudget;
+        bool spinning = true;
+        for ( ; ; ) {
+            std::error_code ec;
+            auto ret = receiveSocket(fd, buf, length, flags | MSG_DONTWAIT, ec);
+            if (!ec) {
+                if (spinning)
+                    ++stats.spinHits;
+                clearError(PTL_ERROR_REF(err));
+                return ret;
+            }
+            int code = ec.value();
+            if (code == EINTR)
+                continue;
+            if (code != EAGAIN && code != EWOULDBLOCK) {
+                handleError(PTL_ERROR_REF(err), code, "recv({}, ,{}) failed", fd, length);
+                return ret;
+            }
+            if (spinning) {
+                ++stats.spinIterations;
+                if (std::chrono::steady_clock::now() < deadline)
+                    continue;
+                spinning = false;
+                ++stats.blockingWaits;
+            }
+            pollfd pfd{fd, POLLIN, 0};
+            if (::poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                handleError(PTL_ERROR_REF(err), errno, "poll({}) failed", fd);
+                return -1;
+            }
+        }
+    }
+
+    #endif
+
+    #ifndef _WIN32
+
+    //Kernel timestamps of a packet. Software timestamps are CLOCK_REALTIME. Hardware ones come from 
+    //the NIC clock and are reported as is.
+    struct PacketTimestamps {
+        std::optional<std::chrono::system_clock::time_point> software;
+        std::optional<std::chrono::nanoseconds> hardware;
+    };
+
+    namespace impl {
+        inline auto timestampFromTimespec(const ::timespec & ts) -> std::chrono::system_clock::time_point {
+            auto sinceEpoch = std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+            return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(sinceEpoch));
+        }
+    }
+
+    //Extracts SCM_TIMESTAMPING, SCM_TIMESTAMPNS and SCM_TIMESTAMP control messages from a received message
+    inline auto parsePacketTimestamps(const msghdr & message) noexcept -> PacketTimestamps {
+        PacketTimestamps ret;
+        auto * msg = const_cast<msghdr *>(&message);
+        for (cmsghdr * cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET)
+                continue;
+            #if defined(SCM_TIMESTAMPING) && __has_include(<linux/errqueue.h>)
+            if (cmsg->cmsg_type == SCM_TIMESTAMPING && cmsg->cmsg_len >= CMSG_LEN(sizeof(scm_timestamping))) {
+                scm_timestamping tss;
+                memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+                if (tss.ts[0].tv_sec || tss.ts[0].tv_nsec)
+                    ret.software = impl::timestampFromTimespec(tss.ts[0]);
+                if (tss.ts[2].tv_sec || tss.ts[2].tv_nsec)
+                    ret.hardware = std::chrono::seconds(tss.ts[2].tv_sec) + std::chrono::nanoseconds(tss.ts[2].tv_nsec);
+                continue;
+            }
+            #endif
+            #ifdef SCM_TIMESTAMPNS
+            if (cmsg->cmsg_type == SCM_TIMESTAMPNS && cmsg->cmsg_len >= CMSG_LEN(sizeof(::timespec))) {
+                ::timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                ret.software = impl::timestampFromTimespec(ts);
+                continue;
+            }
+            #endif
+            #ifdef SCM_TIMESTAMP
+            if (cmsg->cmsg_type == SCM_TIMESTAMP && cmsg->cmsg_len >= CMSG_LEN(sizeof(::timeval))) {
+                ::timeval tv;
+                memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+                auto sinceEpoch = std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec);
+                ret.software = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(sinceEpoch));
+                continue;
+            }
+            #endif
+        }
+        return ret;
+    }
+
+    namespace impl {
+        //enough for SCM_TIMESTAMPING, IP_RECVERR/IPV6_RECVERR with the offender address and a few more
+        constexpr size_t TimestampControlSize = 256;
+    }
+
+    //recv() that also returns the kernel receive timestamps of the datagram. Enable them first via 
+    //SockOptTimestamping, SockOptTimestampNs or SockOptTimestamp.
+    inline auto receiveSocketTimestamped(SocketLike auto && socket, void * buf, io_size_t length, int flags, 
+                                         PacketTimestamps & timestamps,
+                                         PTL_ERROR_REF_ARG(err)) -> io_ssize_t
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        alignas(cmsghdr) char control[impl::TimestampControlSize];
+        iovec iov{buf, length};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto ret = ::recvmsg(fd, &msg, flags);
+        if (ret < 0) {
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "recvmsg({}) failed", fd);
+            timestamps = {};
+        } else {
+            clearError(PTL_ERROR_REF(err));
+            timestamps = parsePacketTimestamps(msg);
+        }
+        return ret;
+    }
+
+    #if defined(SO_TIMESTAMPING) && defined(SO_EE_ORIGIN_TIMESTAMPING) && __has_include(<linux/net_tstamp.h>)
+
+    enum class TimestampingFlags : unsigned {
+        None            = 0,
+        TxHardware      = SOF_TIMESTAMPING_TX_HARDWARE,
+        TxSoftware      = SOF_TIMESTAMPING_TX_SOFTWARE,
+        RxHardware      = SOF_TIMESTAMPING_RX_HARDWARE,
+        RxSoftware      = SOF_TIMESTAMPING_RX_SOFTWARE,
+        Software        = SOF_TIMESTAMPING_SOFTWARE,
+        RawHardware     = SOF_TIMESTAMPING_RAW_HARDWARE,
+        OptId           = SOF_TIMESTAMPING_OPT_ID,
+        TxSched         = SOF_TIMESTAMPING_TX_SCHED,
+        TxAck           = SOF_TIMESTAMPING_TX_ACK,
+        OptCmsg         = SOF_TIMESTAMPING_OPT_CMSG,
+        OptTsOnly       = SOF_TIMESTAMPING_OPT_TSONLY,
+        OptStats        = SOF_TIMESTAMPING_OPT_STATS,
+        OptPktInfo      = SOF_TIMESTAMPING_OPT_PKTINFO,
+        OptTxSwHw       = SOF_TIMESTAMPING_OPT_TX_SWHW
+    };
+
+    constexpr auto operator|(TimestampingFlags lhs, TimestampingFlags rhs) noexcept -> TimestampingFlags
+        { return TimestampingFlags(unsigned(lhs) | unsigned(rhs)); }
+    constexpr auto operator&(TimestampingFlags lhs, TimestampingFlags rhs) noexcept -> TimestampingFlags
+        { return TimestampingFlags(unsigned(lhs) & unsigned(rhs)); }
+    constexpr auto operator|=(TimestampingFlags & lhs, TimestampingFlags rhs) noexcept -> TimestampingFlags &
+        { return lhs = lhs | rhs; }
+
+    enum class TxTimestampType : uint32_t {
+        Sent        = SCM_TSTAMP_SND,       //passed to the device (or NIC for hardware timestamps)
+        Scheduled   = SCM_TSTAMP_SCHED,     //entered the packet scheduler
+        Acked       = SCM_TSTAMP_ACK        //acknowledged by the peer (TCP only)
+    };
+
+    struct TxTimestamp {
+        TxTimestampType type;
+        uint32_t id;                        //with TimestampingFlags::OptId: sequence number of the send (UDP) or byte offset (TCP)
+        PacketTimestamps timestamps;
+    };
+
+    namespace impl {
+        inline auto makeTxTimestamp(const sock_extended_err & ee, const msghdr & msg) noexcept -> TxTimestamp
+            { return TxTimestamp{TxTimestampType(ee.ee_info), ee.ee_data, parsePacketTimestamps(msg)}; }
+    }
+
+    //Retrieves the next transmit timestamp from the socket error queue.
+    //Returns nullopt with no error when the queue is empty. Other notifications, such as zero-copy completions, 
+    //are skipped: use receiveErrorQueueNotification on sockets that use both.
+    inline auto receiveTxTimestamp(SocketLike auto && socket,
+                                   PTL_ERROR_REF_ARG(err)) -> std::optional<TxTimestamp>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        return impl::receiveErrorQueue(fd, [](const sock_extended_err & ee, const msghdr & msg) -> std::optional<TxTimestamp> {
+            if (ee.ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+                return impl::makeTxTimestamp(ee, msg);
+            return std::nullopt;
+        }, PTL_ERROR_REF(err));
+    }
+
+    #if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+
+    using ErrorQueueNotification = std::variant<ZeroCopyCompletion, TxTimestamp>;
+
+    //Retrieves the next zero-copy completion or transmit timestamp, whichever comes first, from the socket 
+    //error queue. Returns nullopt with no error when the queue is empty.
+    inline auto receiveErrorQueueNotification(SocketLike auto && socket,
+                                              PTL_ERROR_REF_ARG(err)) -> std::optional<ErrorQueueNotification>
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        return impl::receiveErrorQueue(fd, [](const sock_extended_err & ee, const msghdr & msg) -> std::optional<ErrorQueueNotification> {
+            if (ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                return impl::makeZeroCopyCompletion(ee);
+            if (ee.ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+                return impl::makeTxTimestamp(ee, msg);
+            return std::nullopt;
+        }, PTL_ERROR_REF(err));
+    }
+
+    #endif
+
+    #endif
+
+    #endif
+
+    inline void setSocketOption(SocketLike auto && socket, 
+                                int level, int option_name, const void * option_value, socklen_t option_len,
+                                PTL_ERROR_REF_ARG(err)) 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::setsockopt(fd, level, option_name, static_cast<const impl::SocketOptionValueType *>(option_value), option_len);
+        if (res != 0)
+            handleError(PTL_ERROR_REF(err), impl::getSocketError(), "setsockopt({}, {}, {}) failed", fd, level, option_name);
+        else
+            clearError(PTL_ERROR_REF(err));
+    }
+
+    inline void getSocketOption(SocketLike auto && socket, 
+                                int level, int option_name, void * option_value, socklen_t * option_len,
+                                PTL_ERROR_REF_ARG(err)) 
+    requires(PTL_ERROR_REQ(err)) {
+        auto fd = c_socket(std::forward<decltype(socket)>(socket));
+        int res = ::getsockopt(fd, level, option_name, static_cast<impl::SocketOptionValueType *>(option_value), option_len);
         if (res != 0)
             handleError(PTL_ERROR_REF(err), impl::getSocketError(), "getsockopt({}, {}, {}) failed", fd, level, option_name);
         else
@@ -395,6 +2608,62 @@ namespace ptl::inline v0 {
         return ret;
     }
 
+    //Options whose value is a short string rather than a fixed size structure.
+    //MaxSize is the size of the buffer used to retrieve the value including the terminating null.
+    template<size_t MaxSize>
+    struct SockOptStringDesc {
+        const int level;
+        const int name;  
+    };
+
+    template<size_t MaxSize>
+    inline void setSocketOption(SocketLike auto && socket, SockOptStringDesc<MaxSize> desc, std::string_view option,
+                                PTL_ERROR_REF_ARG(err)) 
+    requires(PTL_ERROR_REQ(err)) {
+        if (option.size() >= MaxSize)
+            throwErrorCode(EINVAL, "value of size {} for option {}, {} exceeds maximum supported {}", option.size(), desc.level, desc.name, MaxSize - 1);
+        setSocketOption(std::forward<decltype(socket)>(socket), desc.level, desc.name, option.data(), socklen_t(option.size()),
+                        PTL_ERROR_REF(err));
+    }
+
+    template<size_t MaxSize>
+    inline auto getSocketOption(SocketLike auto && socket, SockOptStringDesc<MaxSize> desc,
+                                PTL_ERROR_REF_ARG(err)) -> std::string
+    requires(PTL_ERROR_REQ(err)) {
+        char buf[MaxSize];
+        socklen_t len = socklen_t(sizeof(buf));
+        getSocketOption(std::forward<decltype(socket)>(socket), desc.level, desc.name, buf, &len, PTL_ERROR_REF(err));
+        if (failed(PTL_ERROR_REF(err)))
+            return {};
+        return std::string(buf, strnlen(buf, std::min(size_t(len), sizeof(buf))));
+    }
+
+    //Read-only options whose value is a structure that grows with newer kernels, such as tcp_info.
+    //A kernel older than the headers returns a shorter value and the fields it does not know about are zeroed.
+    template<class T>
+    struct SockOptExtensibleDesc {
+        const int level;
+        const int name;  
+    };
+
+    template<class T>
+    inline void getSocketOption(SocketLike auto && socket, SockOptExtensibleDesc<T> desc, T & option,
+                                PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        option = T{};
+        socklen_t len = socklen_t(sizeof(T));
+        getSocketOption(std::forward<decltype(socket)>(socket), desc.level, desc.name, &option, &len, PTL_ERROR_REF(err));
+    }
+
+    template<class T>
+    inline auto getSocketOption(SocketLike auto && socket, SockOptExtensibleDesc<T> desc,
+                                PTL_ERROR_REF_ARG(err)) -> T
+    requires(PTL_ERROR_REQ(err)) {
+        T ret;
+        getSocketOption(std::forward<decltype(socket)>(socket), desc, ret, PTL_ERROR_REF(err));
+        return ret;
+    }
+
     //Posix options
 
     constexpr auto SockOptDebug              = SockOptDesc<bool>            {SOL_SOCKET, SO_DEBUG};
@@ -444,6 +2713,9 @@ namespace ptl::inline v0 {
     #ifdef SO_TIMESTAMPNS
         constexpr auto SockOptTimestampNs        = SockOptDesc<bool>        {SOL_SOCKET, SO_TIMESTAMPNS};
     #endif
+    #if defined(SO_TIMESTAMPING) && defined(SO_EE_ORIGIN_TIMESTAMPING) && __has_include(<linux/net_tstamp.h>)
+        constexpr auto SockOptTimestamping       = SockOptDesc<TimestampingFlags> {SOL_SOCKET, SO_TIMESTAMPING};
+    #endif
     #ifdef SO_TIMESTAMP_MONOTONIC
         constexpr auto SockOptTimestampMonotonic = SockOptDesc<bool>        {SOL_SOCKET, SO_TIMESTAMP_MONOTONIC};
     #endif
@@ -456,6 +2728,35 @@ namespace ptl::inline v0 {
     #ifdef SO_BSP_STATE
         constexpr auto SockOptBspState           = SockOptDesc<CSADDR_INFO> {SOL_SOCKET, SO_BSP_STATE};
     #endif
+    #ifdef SO_ZEROCOPY
+        constexpr auto SockOptZeroCopy           = SockOptDesc<bool>        {SOL_SOCKET, SO_ZEROCOPY};
+    #endif
+    #ifdef SO_BUSY_POLL
+        constexpr auto SockOptBusyPoll           = SockOptDesc<unsigned, 
+                                                               int>         {SOL_SOCKET, SO_BUSY_POLL};
+    #endif
+    #ifdef SO_PREFER_BUSY_POLL
+        constexpr auto SockOptPreferBusyPoll     = SockOptDesc<bool>        {SOL_SOCKET, SO_PREFER_BUSY_POLL};
+    #endif
+    #ifdef SO_BUSY_POLL_BUDGET
+        constexpr auto SockOptBusyPollBudget     = SockOptDesc<unsigned, 
+                                                               int>         {SOL_SOCKET, SO_BUSY_POLL_BUDGET};
+    #endif
+    #ifdef SO_INCOMING_CPU
+        constexpr auto SockOptIncomingCPU        = SockOptDesc<int>         {SOL_SOCKET, SO_INCOMING_CPU};
+    #endif
+    #ifdef SO_ATTACH_REUSEPORT_CBPF
+        constexpr auto SockOptAttachReusePortCBPF= SockOptDesc<::sock_fprog>{SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF};
+    #endif
+    #ifdef SO_ATTACH_FILTER
+        constexpr auto SockOptAttachFilter       = SockOptDesc<::sock_fprog>{SOL_SOCKET, SO_ATTACH_FILTER};
+    #endif
+    #ifdef SO_DETACH_FILTER
+        constexpr auto SockOptDetachFilter       = SockOptDesc<int>         {SOL_SOCKET, SO_DETACH_FILTER};
+    #endif
+    #ifdef SO_LOCK_FILTER
+        constexpr auto SockOptLockFilter         = SockOptDesc<bool>        {SOL_SOCKET, SO_LOCK_FILTER};
+    #endif
     #ifdef SO_EXCLUSIVEADDRUSE
         constexpr auto SockOptExclusiveAddrUse   = SockOptDesc<bool>        {SOL_SOCKET, SO_EXCLUSIVEADDRUSE};
     #endif
@@ -511,6 +2812,841 @@ namespace ptl::inline v0 {
         constexpr auto SockOptIPv6MulticastAll      = SockOptDesc<bool>     {IPPROTO_IPV6, IPV6_MULTICAST_ALL};
     #endif
 
+    //IPPROTO_TCP options
+    #ifdef TCP_NODELAY
+        constexpr auto SockOptTCPNoDelay            = SockOptDesc<bool>     {IPPROTO_TCP, TCP_NODELAY};
+    #endif
+    #ifdef TCP_CORK
+        constexpr auto SockOptTCPCork               = SockOptDesc<bool>     {IPPROTO_TCP, TCP_CORK};
+    #endif
+    #ifdef TCP_QUICKACK
+        constexpr auto SockOptTCPQuickAck           = SockOptDesc<bool>     {IPPROTO_TCP, TCP_QUICKACK};
+    #endif
+    #ifdef TCP_FASTOPEN
+        constexpr auto SockOptTCPFastOpen           = SockOptDesc<int>      {IPPROTO_TCP, TCP_FASTOPEN};
+    #endif
+    #ifdef TCP_FASTOPEN_CONNECT
+        constexpr auto SockOptTCPFastOpenConnect    = SockOptDesc<bool>     {IPPROTO_TCP, TCP_FASTOPEN_CONNECT};
+    #endif
+    #ifdef TCP_DEFER_ACCEPT
+        constexpr auto SockOptTCPDeferAccept        = SockOptDesc<int>      {IPPROTO_TCP, TCP_DEFER_ACCEPT};
+    #endif
+    #ifdef TCP_NOTSENT_LOWAT
+        constexpr auto SockOptTCPNotSentLowWatermark= SockOptDesc<unsigned, 
+                                                                  int>      {IPPROTO_TCP, TCP_NOTSENT_LOWAT};
+    #endif
+    #ifdef TCP_USER_TIMEOUT
+        constexpr auto SockOptTCPUserTimeout        = SockOptDesc<unsigned, 
+                                                                  int>      {IPPROTO_TCP, TCP_USER_TIMEOUT};
+    #endif
+    #ifdef TCP_KEEPIDLE
+        constexpr auto SockOptTCPKeepIdle           = SockOptDesc<int>      {IPPROTO_TCP, TCP_KEEPIDLE};
+    #elif defined(__APPLE__) && defined(TCP_KEEPALIVE)
+        constexpr auto SockOptTCPKeepIdle           = SockOptDesc<int>      {IPPROTO_TCP, TCP_KEEPALIVE};
+    #endif
+    #ifdef TCP_KEEPINTVL
+        constexpr auto SockOptTCPKeepInterval       = SockOptDesc<int>      {IPPROTO_TCP, TCP_KEEPINTVL};
+    #endif
+    #ifdef TCP_KEEPCNT
+        constexpr auto SockOptTCPKeepCount          = SockOptDesc<int>      {IPPROTO_TCP, TCP_KEEPCNT};
+    #endif
+    #ifdef TCP_INFO
+        constexpr auto SockOptTCPInfo               = SockOptExtensibleDesc<::tcp_info> {IPPROTO_TCP, TCP_INFO};
+    #endif
+    #ifdef TCP_CONGESTION
+        #ifdef TCP_CA_NAME_MAX
+        constexpr auto SockOptTCPCongestion         = SockOptStringDesc<TCP_CA_NAME_MAX>    {IPPROTO_TCP, TCP_CONGESTION};
+        #else
+        constexpr auto SockOptTCPCongestion         = SockOptStringDesc<16> {IPPROTO_TCP, TCP_CONGESTION};
+        #endif
+    #endif
+    #ifdef TCP_ULP
+        constexpr auto SockOptTCPUlp                = SockOptStringDesc<16> {IPPROTO_TCP, TCP_ULP};
+    #endif
+
+    //IPPROTO_UDP options
+    #ifdef UDP_SEGMENT
+        constexpr auto SockOptUDPSegment            = SockOptDesc<int>      {IPPROTO_UDP, UDP_SEGMENT};
+    #endif
+    #ifdef UDP_GRO
+        constexpr auto SockOptUDPGro                = SockOptDesc<bool>     {IPPROTO_UDP, UDP_GRO};
+    #endif
+
+    #if defined(SO_ATTACH_FILTER) && __has_include(<linux/filter.h>)
+
+    //A classic BPF program of at most Capacity instructions built in place. Jump offsets are 
+    //relative to the next instruction as in BPF_JUMP. All members are constexpr.
+    template<size_t Capacity>
+    class BpfProgram {
+    public:
+        static constexpr uint32_t AcceptAll = std::numeric_limits<uint32_t>::max();
+
+        constexpr BpfProgram() noexcept = default;
+
+        //load into accumulator. Multi-byte loads convert from network byte order
+        constexpr auto loadByte(uint32_t offset) -> BpfProgram &
+            { return statement(BPF_LD | BPF_B | BPF_ABS, offset); }
+        constexpr auto loadHalf(uint32_t offset) -> BpfProgram &
+            { return statement(BPF_LD | BPF_H | BPF_ABS, offset); }
+        constexpr auto loadWord(uint32_t offset) -> BpfProgram &
+            { return statement(BPF_LD | BPF_W | BPF_ABS, offset); }
+        constexpr auto loadLength() -> BpfProgram &
+            { return statement(BPF_LD | BPF_W | BPF_LEN, 0); }
+        constexpr auto loadConstant(uint32_t value) -> BpfProgram &
+            { return statement(BPF_LD | BPF_IMM, value); }
+        constexpr auto bitAnd(uint32_t mask) -> BpfProgram &
+            { return statement(BPF_ALU | BPF_AND | BPF_K, mask); }
+
+        //compare accumulator with value
+        constexpr auto jumpIfEqual(uint32_t value, uint8_t jumpTrue, uint8_t jumpFalse) -> BpfProgram &
+            { return jump(BPF_JMP | BPF_JEQ | BPF_K, value, jumpTrue, jumpFalse); }
+        constexpr auto jumpIfGreater(uint32_t value, uint8_t jumpTrue, uint8_t jumpFalse) -> BpfProgram &
+            { return jump(BPF_JMP | BPF_JGT | BPF_K, value, jumpTrue, jumpFalse); }
+        constexpr auto jumpIfGreaterOrEqual(uint32_t value, uint8_t jumpTrue, uint8_t jumpFalse) -> BpfProgram &
+            { return jump(BPF_JMP | BPF_JGE | BPF_K, value, jumpTrue, jumpFalse); }
+        constexpr auto jumpIfAnySet(uint32_t mask, uint8_t jumpTrue, uint8_t jumpFalse) -> BpfProgram &
+            { return jump(BPF_JMP | BPF_JSET | BPF_K, mask, jumpTrue, jumpFalse); }
+        constexpr auto jumpAlways(uint32_t offset) -> BpfProgram &
+            { return statement(BPF_JMP | BPF_JA, offset); }
+
+        //keep up to bytes of the packet
+        constexpr auto accept(uint32_t bytes = AcceptAll) -> BpfProgram &
+            { return statement(BPF_RET | BPF_K, bytes); }
+        constexpr auto reject() -> BpfProgram &
+            { return statement(BPF_RET | BPF_K, 0); }
+
+        //raw instructions for anything not covered above
+        constexpr auto statement(uint16_t code, uint32_t k) -> BpfProgram &
+            { return jump(code, k, 0, 0); }
+        constexpr auto jump(uint16_t code, uint32_t k, uint8_t jumpTrue, uint8_t jumpFalse) -> BpfProgram & {
+            if (m_size == Capacity)
+                throwErrorCode(EINVAL, "BPF program exceeds its capacity of {} instructions", Capacity);
+            m_code[m_size++] = ::sock_filter{code, jumpTrue, jumpFalse, k};
+            return *this;
+        }
+
+        //all jumps land inside the program and it ends with a return
+        constexpr auto valid() const noexcept -> bool {
+            if (m_size == 0 || BPF_CLASS(m_code[m_size - 1].code) != BPF_RET)
+                return false;
+            for (size_t i = 0; i < m_size; ++i) {
+                auto & insn = m_code[i];
+                if (BPF_CLASS(insn.code) != BPF_JMP)
+                    continue;
+                size_t furthest = BPF_OP(insn.code) == BPF_JA ? insn.k : std::max(insn.jt, insn.jf);
+                if (furthest >= m_size - i - 1)
+                    return false;
+            }
+            return true;
+        }
+
+        constexpr auto size() const noexcept -> size_t
+            { return m_size; }
+        constexpr auto instructions() const noexcept -> std::span<const ::sock_filter>
+            { return {m_code.data(), m_size}; }
+        //the kernel only reads the instructions
+        auto fprog() const noexcept -> ::sock_fprog
+            { return {static_cast<unsigned short>(m_size), const_cast<::sock_filter *>(m_code.data())}; }
+    private:
+        std::array<::sock_filter, Capacity> m_code{};
+        size_t m_size = 0;
+    };
+
+    //offset of the payload for filters attached to UDP sockets, which see data starting at the UDP header
+    constexpr uint32_t BpfUdpPayloadOffset = 8;
+
+    //accept packets whose byte at offset equals value
+    constexpr auto bpfMatchByte(uint32_t offset, uint8_t value) -> BpfProgram<4> {
+        BpfProgram<4> ret;
+        ret.loadByte(offset).jumpIfEqual(value, 0, 1).accept().reject();
+        return ret;
+    }
+
+    //accept packets whose 16-bit big endian field at offset equals value
+    constexpr auto bpfMatchHalf(uint32_t offset, uint16_t value) -> BpfProgram<4> {
+        BpfProgram<4> ret;
+        ret.loadHalf(offset).jumpIfEqual(value, 0, 1).accept().reject();
+        return ret;
+    }
+
+    //accept packets whose length as seen by the filter is in [min, max]
+    constexpr auto bpfLengthRange(uint32_t min, uint32_t max) -> BpfProgram<5> {
+        BpfProgram<5> ret;
+        ret.loadLength().jumpIfGreaterOrEqual(min, 0, 2).jumpIfGreater(max, 1, 0).accept().reject();
+        return ret;
+    }
+
+    constexpr auto bpfUdpSourcePort(uint16_t port) -> BpfProgram<4>
+        { return bpfMatchHalf(0, port); }
+
+    constexpr auto bpfUdpFirstByte(uint8_t value) -> BpfProgram<4>
+        { return bpfMatchByte(BpfUdpPayloadOffset, value); }
+
+    template<size_t Capacity>
+    inline void attachSocketFilter(SocketLike auto && socket, const BpfProgram<Capacity> & program,
+                                   PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        if (!program.valid())
+            throwErrorCode(EINVAL, "invalid BPF program of {} instructions", program.size());
+        setSocketOption(std::forward<decltype(socket)>(socket), SockOptAttachFilter, program.fprog(), PTL_ERROR_REF(err));
+    }
+
+    #ifdef SO_DETACH_FILTER
+    inline void detachSocketFilter(SocketLike auto && socket,
+                                   PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        setSocketOption(std::forward<decltype(socket)>(socket), SockOptDetachFilter, 0, PTL_ERROR_REF(err));
+    }
+    #endif
+
+    #ifdef SO_LOCK_FILTER
+    //prevents detaching or replacing the filter for the lifetime of the socket
+    inline void lockSocketFilter(SocketLike auto && socket,
+                                 PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        setSocketOption(std::forward<decltype(socket)>(socket), SockOptLockFilter, true, PTL_ERROR_REF(err));
+    }
+    #endif
+
+    #endif
+
+    #if defined(__linux__) && defined(TCP_INFO)
+
+    namespace impl {
+        //Kernel's struct tcp_info is append-only and libc headers disagree on how much of it they declare:
+        //glibc stops at tcpi_total_retrans while musl and bionic have the full structure. This is a copy of 
+        //the kernel UAPI layout up to tcpi_bytes_retrans that does not depend on either.
+        struct LinuxTcpInfo {
+            uint8_t tcpi_state;
+            uint8_t tcpi_ca_state;
+            uint8_t tcpi_retransmits;
+            uint8_t tcpi_probes;
+            uint8_t tcpi_backoff;
+            uint8_t tcpi_options;
+            uint8_t tcpi_wscale;                //tcpi_snd_wscale : 4, tcpi_rcv_wscale : 4
+            uint8_t tcpi_flags;                 //tcpi_delivery_rate_app_limited : 1, tcpi_fastopen_client_fail : 2
+
+            uint32_t tcpi_rto;
+            uint32_t tcpi_ato;
+            uint32_t tcpi_snd_mss;
+            uint32_t tcpi_rcv_mss;
+
+            uint32_t tcpi_unacked;
+            uint32_t tcpi_sacked;
+            uint32_t tcpi_lost;
+            uint32_t tcpi_retrans;
+            uint32_t tcpi_fackets;
+
+            uint32_t tcpi_last_data_sent;
+            uint32_t tcpi_last_ack_sent;
+            uint32_t tcpi_last_data_recv;
+            uint32_t tcpi_last_ack_recv;
+
+            uint32_t tcpi_pmtu;
+            uint32_t tcpi_rcv_ssthresh;
+            uint32_t tcpi_rtt;
+            uint32_t tcpi_rttvar;
+            uint32_t tcpi_snd_ssthresh;
+            uint32_t tcpi_snd_cwnd;
+            uint32_t tcpi_advmss;
+            uint32_t tcpi_reordering;
+
+            uint32_t tcpi_rcv_rtt;
+            uint32_t tcpi_rcv_space;
+
+            uint32_t tcpi_total_retrans;
+
+            uint64_t tcpi_pacing_rate;
+            uint64_t tcpi_max_pacing_rate;
+            uint64_t tcpi_bytes_acked;
+            uint64_t tcpi_bytes_received;
+            uint32_t tcpi_segs_out;
+            uint32_t tcpi_segs_in;
+            uint32_t tcpi_notsent_bytes;
+            uint32_t tcpi_min_rtt;
+            uint32_t tcpi_data_segs_in;
+            uint32_t tcpi_data_segs_out;
+            uint64_t tcpi_delivery_rate;
+            uint64_t tcpi_busy_time;
+            uint64_t tcpi_rwnd_limited;
+            uint64_t tcpi_sndbuf_limited;
+            uint32_t tcpi_delivered;
+            uint32_t tcpi_delivered_ce;
+            uint64_t tcpi_bytes_sent;
+            uint64_t tcpi_bytes_retrans;
+        };
+
+        //offsets from include/uapi/linux/tcp.h
+        static_assert(offsetof(LinuxTcpInfo, tcpi_rto) == 8);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_rtt) == 68);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_total_retrans) == 100);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_pacing_rate) == 104);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_segs_out) == 136);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_delivery_rate) == 160);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_delivered) == 192);
+        static_assert(offsetof(LinuxTcpInfo, tcpi_bytes_retrans) == 208);
+        //and whatever the libc declares has to agree
+        static_assert(offsetof(LinuxTcpInfo, tcpi_snd_mss) == offsetof(::tcp_info, tcpi_snd_mss));
+        static_assert(offsetof(LinuxTcpInfo, tcpi_rtt) == offsetof(::tcp_info, tcpi_rtt));
+        static_assert(offsetof(LinuxTcpInfo, tcpi_snd_cwnd) == offsetof(::tcp_info, tcpi_snd_cwnd));
+        static_assert(offsetof(LinuxTcpInfo, tcpi_total_retrans) == offsetof(::tcp_info, tcpi_total_retrans));
+    }
+
+    //Normalized TCP connection statistics. Fields not reported by the running kernel are 0.
+    struct TcpInfo {
+        std::chrono::steady_clock::time_point time;
+        uint8_t state;
+        uint8_t retransmits;                        //consecutive retransmission timeouts
+        std::chrono::microseconds rtt;
+        std::chrono::microseconds rttVariance;
+        std::chrono::microseconds minRtt;
+        uint32_t mss;
+        uint32_t congestionWindow;                  //segments
+        uint32_t slowStartThreshold;                //segments
+        uint32_t unackedSegments;
+        uint32_t lostSegments;
+        uint32_t notSentBytes;
+        uint64_t totalRetransmits;                  //segments
+        uint64_t bytesSent;
+        uint64_t bytesAcked;
+        uint64_t bytesReceived;
+        uint64_t bytesRetransmitted;
+        uint64_t segmentsOut;
+        uint64_t segmentsIn;
+        uint64_t deliveryRate;                      //bytes per second
+        uint64_t pacingRate;                        //bytes per second
+    };
+
+    inline auto getTcpInfo(SocketLike auto && socket,
+                           PTL_ERROR_REF_ARG(err)) -> TcpInfo
+    requires(PTL_ERROR_REQ(err)) {
+        impl::LinuxTcpInfo raw{};
+        socklen_t len = socklen_t(sizeof(raw));
+        getSocketOption(std::forward<decltype(socket)>(socket), IPPROTO_TCP, TCP_INFO, &raw, &len, PTL_ERROR_REF(err));
+        TcpInfo ret{};
+        ret.time = std::chrono::steady_clock::now();
+        if (failed(PTL_ERROR_REF(err)))
+            return ret;
+        //fields beyond len are left zeroed by the value initialization above
+        ret.state = raw.tcpi_state;
+        ret.retransmits = raw.tcpi_retransmits;
+        ret.rtt = std::chrono::microseconds(raw.tcpi_rtt);
+        ret.rttVariance = std::chrono::microseconds(raw.tcpi_rttvar);
+        ret.minRtt = std::chrono::microseconds(raw.tcpi_min_rtt);
+        ret.mss = raw.tcpi_snd_mss;
+        ret.congestionWindow = raw.tcpi_snd_cwnd;
+        ret.slowStartThreshold = raw.tcpi_snd_ssthresh;
+        ret.unackedSegments = raw.tcpi_unacked;
+        ret.lostSegments = raw.tcpi_lost;
+        ret.notSentBytes = raw.tcpi_notsent_bytes;
+        ret.totalRetransmits = raw.tcpi_total_retrans;
+        ret.bytesSent = raw.tcpi_bytes_sent;
+        ret.bytesAcked = raw.tcpi_bytes_acked;
+        ret.bytesReceived = raw.tcpi_bytes_received;
+        ret.bytesRetransmitted = raw.tcpi_bytes_retrans;
+        ret.segmentsOut = raw.tcpi_segs_out;
+        ret.segmentsIn = raw.tcpi_segs_in;
+        ret.deliveryRate = raw.tcpi_delivery_rate;
+        ret.pacingRate = raw.tcpi_pacing_rate;
+        return ret;
+    }
+
+    //Change between two consecutive samples of the same connection
+    struct TcpInfoDelta {
+        std::chrono::nanoseconds interval;
+        uint64_t bytesSent;
+        uint64_t bytesAcked;
+        uint64_t bytesReceived;
+        uint64_t bytesRetransmitted;
+        uint64_t segmentsOut;
+        uint64_t segmentsIn;
+        uint64_t retransmits;
+
+        static auto between(const TcpInfo & prev, const TcpInfo & current) noexcept -> TcpInfoDelta {
+            //64-bit kernel counters never decrease for a given connection
+            auto diff = [](uint64_t from, uint64_t to) { return to >= from ? to - from : 0; };
+            //these come from 32-bit kernel counters that can wrap between samples
+            auto diff32 = [](uint64_t from, uint64_t to) { return uint64_t(uint32_t(to - from)); };
+            return {
+                .interval = current.time - prev.time,
+                .bytesSent = diff(prev.bytesSent, current.bytesSent),
+                .bytesAcked = diff(prev.bytesAcked, current.bytesAcked),
+                .bytesReceived = diff(prev.bytesReceived, current.bytesReceived),
+                .bytesRetransmitted = diff(prev.bytesRetransmitted, current.bytesRetransmitted),
+                .segmentsOut = diff32(prev.segmentsOut, current.segmentsOut),
+                .segmentsIn = diff32(prev.segmentsIn, current.segmentsIn),
+                .retransmits = diff32(prev.totalRetransmits, current.totalRetransmits)
+            };
+        }
+    };
+
+    //Polls TCP_INFO for a set of sockets at most once per interval and reports deltas between consecutive samples. 
+    //The sampler does not own the sockets and does not create any threads: call poll() from your own loop or timer.
+    class TcpInfoSampler {
+    public:
+        explicit TcpInfoSampler(std::chrono::nanoseconds interval) noexcept:
+            m_interval(interval) {
+        }
+
+        auto interval() const noexcept -> std::chrono::nanoseconds
+            { return m_interval; }
+        auto size() const noexcept -> size_t
+            { return m_entries.size(); }
+        auto nextSampleTime() const noexcept -> std::chrono::steady_clock::time_point {
+            if (!m_lastSample)
+                return std::chrono::steady_clock::time_point::min();
+            return *m_lastSample + m_interval; 
+        }
+
+        void add(SocketLike auto && socket) {
+            auto fd = c_socket(std::forward<decltype(socket)>(socket));
+            if (std::find_if(m_entries.begin(), m_entries.end(), [fd](const Entry & e) { return e.fd == fd; }) == m_entries.end())
+                m_entries.push_back({fd, {}, false});
+        }
+
+        //Remove sockets before closing them, otherwise a reused descriptor will be sampled as the same connection
+        void remove(SocketLike auto && socket) noexcept {
+            auto fd = c_socket(std::forward<decltype(socket)>(socket));
+            std::erase_if(m_entries, [fd](const Entry & e) { return e.fd == fd; });
+        }
+
+        //Samples all sockets if the interval has elapsed since the last sample. For each socket that has a 
+        //previous sample calls callback(fd, const TcpInfo & current, const TcpInfoDelta & delta).
+        //Sockets for which TCP_INFO cannot be retrieved are removed from the set.
+        //The callback must not add or remove sockets. Returns the number of callbacks made.
+        template<class Callback>
+        auto poll(Callback && callback, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) -> size_t {
+            if (now < nextSampleTime())
+                return 0;
+            return sample(std::forward<Callback>(callback), now);
+        }
+
+        //Same as poll() but samples unconditionally. Samples are stamped with now.
+        template<class Callback>
+        auto sample(Callback && callback, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) -> size_t {
+            m_lastSample = now;
+            size_t count = 0;
+            for (size_t i = 0; i < m_entries.size(); ) {
+                auto & entry = m_entries[i];
+                std::error_code ec;
+                auto current = getTcpInfo(entry.fd, ec);
+                current.time = now;
+                if (ec) {
+                    entry = m_entries.back();
+                    m_entries.pop_back();
+                    continue;
+                }
+                if (entry.sampled) {
+                    callback(entry.fd, std::as_const(current), TcpInfoDelta::between(entry.last, current));
+                    ++count;
+                }
+                entry.last = current;
+                entry.sampled = true;
+                ++i;
+            }
+            return count;
+        }
+    private:
+        struct Entry {
+            int fd;
+            TcpInfo last;
+            bool sampled;
+        };
+        std::vector<Entry> m_entries;
+        std::chrono::nanoseconds m_interval;
+        std::optional<std::chrono::steady_clock::time_point> m_lastSample;
+    };
+
+    #endif
+
+    #ifdef SO_REUSEPORT
+
+    enum class ReusePortSteering {
+        None,           //kernel default: hash of the connection 4-tuple
+    #ifdef SO_INCOMING_CPU
+        IncomingCPU,    //listener i is marked with SO_INCOMING_CPU = i 
+    #endif
+    #if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+        CPUFilter       //classic BPF program selecting listener (receiving CPU % size)
+    #endif
+    };
+
+    //A set of listening stream sockets bound to the same address via SO_REUSEPORT.
+    //Listener i is meant to be served by a thread pinned to CPU i.
+    class ReusePortGroup {
+    public:
+        ReusePortGroup() noexcept = default;
+
+        static auto create(const SocketAddress & address, size_t count, int backlog, ReusePortSteering steering,
+                           PTL_ERROR_REF_ARG(err)) -> ReusePortGroup 
+        requires(PTL_ERROR_REQ(err)) {
+            if (count == 0 || count > std::numeric_limits<uint32_t>::max())
+                throwErrorCode(EINVAL, "invalid SO_REUSEPORT group size {}", count);
+            
+            ReusePortGroup ret;
+            ret.m_listeners.reserve(count);
+            SocketAddress bindAddress = address;
+            for (size_t i = 0; i < count; ++i) {
+                auto sock = createSocket(address.family(), SOCK_STREAM, 0, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+                setSocketOption(sock, SockOptReusePort, true, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+                #ifdef SO_INCOMING_CPU
+                if (steering == ReusePortSteering::IncomingCPU) {
+                    setSocketOption(sock, SockOptIncomingCPU, int(i), PTL_ERROR_REF(err));
+                    if (failed(PTL_ERROR_REF(err)))
+                        return {};
+                }
+                #endif
+                bindSocket(sock, bindAddress, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+                //if the port was 0 make the rest of the group use the one the kernel chose
+                if (i == 0) {
+                    bindAddress = getSocketName(sock, PTL_ERROR_REF(err));
+                    if (failed(PTL_ERROR_REF(err)))
+                        return {};
+                }
+                ret.m_listeners.push_back(std::move(sock));
+            }
+            //listening in order makes the kernel's group index match the index in m_listeners
+            for (auto & sock: ret.m_listeners) {
+                listenSocket(sock, backlog, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+            }
+            #if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+            if (steering == ReusePortSteering::CPUFilter) {
+                //the program applies to the whole group so attaching to one socket is enough.
+                //It must be attached after listen: attaching to an unhashed socket creates a separate group.
+                ::sock_filter code[] = {
+                    BPF_STMT(BPF_LD  | BPF_W | BPF_ABS, uint32_t(SKF_AD_OFF + SKF_AD_CPU)),
+                    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, uint32_t(count)),
+                    BPF_STMT(BPF_RET | BPF_A, 0)
+                };
+                ::sock_fprog prog{static_cast<unsigned short>(std::size(code)), code};
+                setSocketOption(ret.m_listeners[0], SockOptAttachReusePortCBPF, prog, PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return {};
+            }
+            #endif
+            ret.m_address = bindAddress;
+            return ret;
+        }
+
+        auto size() const noexcept -> size_t 
+            { return m_listeners.size(); }
+        auto operator[](size_t idx) const noexcept -> const Socket & 
+            { return m_listeners[idx]; }
+        auto listeners() const noexcept -> std::span<const Socket> 
+            { return m_listeners; }
+        //actual bound address, with the port filled in if 0 was requested
+        auto address() const noexcept -> const SocketAddress & 
+            { return m_address; }
+
+        explicit operator bool() const noexcept 
+            { return !m_listeners.empty(); }
+    private:
+        std::vector<Socket> m_listeners;
+        SocketAddress m_address;
+    };
+
+    #endif
+
+    #ifndef _WIN32
+
+    namespace impl {
+        #ifdef MSG_NOSIGNAL
+            //a vanished peer should be an EPIPE error, not a signal
+            constexpr int ChannelSendFlags = MSG_NOSIGNAL;
+        #else
+            constexpr int ChannelSendFlags = 0;
+        #endif
+        #ifdef MSG_CMSG_CLOEXEC
+            constexpr int ChannelReceiveFlags = MSG_CMSG_CLOEXEC;
+        #else
+            constexpr int ChannelReceiveFlags = 0;
+        #endif
+
+        constexpr auto isUnsupportedSocketType(int code) noexcept -> bool {
+            return code == EPROTONOSUPPORT || code == EPROTOTYPE || code == EOPNOTSUPP
+            #ifdef ESOCKTNOSUPPORT
+                || code == ESOCKTNOSUPPORT
+            #endif
+            ;
+        }
+    }
+
+    //A connected local socket that preserves message boundaries and can carry descriptors.
+    //Uses SOCK_SEQPACKET where the platform supports it and SOCK_DGRAM otherwise.
+    class MessageChannel {
+    public:
+        //the most descriptors a single message can carry
+        static constexpr size_t maxDescriptors = 16;
+
+        struct Received {
+            //bytes received, -1 on error
+            io_ssize_t size = -1;
+            //number of descriptors stored into the supplied span
+            size_t descriptors = 0;
+            //the message was larger than the buffer and its tail was discarded
+            bool truncated = false;
+            //some descriptors did not fit and were closed
+            bool descriptorsTruncated = false;
+        };
+
+        MessageChannel() noexcept = default;
+        explicit MessageChannel(Socket socket) noexcept :
+            m_socket(std::move(socket))
+        {}
+
+        //flags are OR-ed into the socket type, e.g. SOCK_CLOEXEC or SOCK_NONBLOCK. 
+        //Non-zero bufferSize sets send and receive buffers of both ends.
+        static auto createPair(size_t bufferSize, int flags,
+                               PTL_ERROR_REF_ARG(err)) -> std::pair<MessageChannel, MessageChannel> 
+        requires(PTL_ERROR_REQ(err)) {
+            int fds[2];
+            int res = ::socketpair(AF_UNIX, SOCK_SEQPACKET | flags, 0, fds);
+            if (res != 0 && impl::isUnsupportedSocketType(errno))
+                res = ::socketpair(AF_UNIX, SOCK_DGRAM | flags, 0, fds);
+            if (res != 0) {
+                handleError(PTL_ERROR_REF(err), impl::getSocketError(), "socketpair(AF_UNIX, {}) failed", flags);
+                return {};
+            }
+            std::pair<MessageChannel, MessageChannel> ret{MessageChannel(Socket(fds[0])), MessageChannel(Socket(fds[1]))};
+            if (bufferSize) {
+                for (auto * channel: {&ret.first, &ret.second}) {
+                    channel->setBufferSize(bufferSize, PTL_ERROR_REF(err));
+                    if (failed(PTL_ERROR_REF(err)))
+                        return {};
+                }
+            }
+            clearError(PTL_ERROR_REF(err));
+            return ret;
+        }
+        static auto createPair(PTL_ERROR_REF_ARG(err)) -> std::pair<MessageChannel, MessageChannel> 
+        requires(PTL_ERROR_REQ(err)) {
+            return createPair(0, 0, PTL_ERROR_REF(err));
+        }
+
+        //the kernel may round the size or, on Linux, double it
+        void setBufferSize(size_t size, 
+                           PTL_ERROR_REF_ARG(err)) 
+        requires(PTL_ERROR_REQ(err)) {
+            const auto value = unsigned(std::min(size, size_t(std::numeric_limits<int>::max())));
+            setSocketOption(m_socket, SockOptSndBuf, value, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return;
+            setSocketOption(m_socket, SockOptRcvBuf, value, PTL_ERROR_REF(err));
+        }
+
+        auto send(const void * buf, size_t size, int flags,
+                  PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+        requires(PTL_ERROR_REQ(err)) {
+            return sendSocket(m_socket, buf, size, flags | impl::ChannelSendFlags, PTL_ERROR_REF(err));
+        }
+
+        auto send(const void * buf, size_t size, std::span<const int> descriptors, int flags,
+                  PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+        requires(PTL_ERROR_REQ(err)) {
+            if (descriptors.size() > maxDescriptors)
+                throwErrorCode(EINVAL, "cannot send {} descriptors in one message, maximum is {}", descriptors.size(), maxDescriptors);
+            MessageHeader<1, ControlMessageSpace<int[maxDescriptors]>> msg;
+            msg.payload(buf, size);
+            if (!descriptors.empty())
+                msg.control(SOL_SOCKET, SCM_RIGHTS, descriptors);
+            return sendSocket(m_socket, msg, flags | impl::ChannelSendFlags, PTL_ERROR_REF(err));
+        }
+
+        auto receive(void * buf, size_t size, int flags,
+                     PTL_ERROR_REF_ARG(err)) -> io_ssize_t 
+        requires(PTL_ERROR_REQ(err)) {
+            return receiveSocket(m_socket, buf, size, flags, PTL_ERROR_REF(err));
+        }
+
+        //received descriptors are close-on-exec where the platform allows it
+        auto receive(void * buf, size_t size, std::span<FileDescriptor> descriptors, int flags,
+                     PTL_ERROR_REF_ARG(err)) -> Received 
+        requires(PTL_ERROR_REQ(err)) {
+            MessageHeader<1, ControlMessageSpace<int[maxDescriptors]>> msg;
+            msg.payload(buf, size);
+            Received ret;
+            ret.size = receiveSocket(m_socket, msg, flags | impl::ChannelReceiveFlags, PTL_ERROR_REF(err));
+            if (ret.size < 0)
+                return ret;
+            ret.truncated = msg.flags() & MSG_TRUNC;
+            ret.descriptorsTruncated = msg.controlTruncated();
+            for (ControlMessage cmsg: msg.controlMessages()) {
+                if (!cmsg.is(SOL_SOCKET, SCM_RIGHTS))
+                    continue;
+                for (size_t i = 0, fdCount = cmsg.count<int>(); i < fdCount; ++i) {
+                    FileDescriptor fd(*cmsg.as<int>(i));
+                    if (ret.descriptors < descriptors.size())
+                        descriptors[ret.descriptors++] = std::move(fd);
+                    else
+                        ret.descriptorsTruncated = true;
+                }
+            }
+            return ret;
+        }
+
+        //messages are taken from batch buffers set up via SocketBatch::setMessage(idx, length)
+        auto sendBatch(SocketBatch & batch, size_t count, int flags,
+                       PTL_ERROR_REF_ARG(err)) -> size_t 
+        requires(PTL_ERROR_REQ(err)) {
+            return sendSocketBatch(m_socket, batch, count, flags | impl::ChannelSendFlags, PTL_ERROR_REF(err));
+        }
+
+        auto receiveBatch(SocketBatch & batch, int flags,
+                          PTL_ERROR_REF_ARG(err)) -> size_t 
+        requires(PTL_ERROR_REQ(err)) {
+            return receiveSocketBatch(m_socket, batch, flags, PTL_ERROR_REF(err));
+        }
+
+        auto socket() const noexcept -> const Socket &
+            { return m_socket; }
+        //give up ownership, e.g. to hand the socket to a child process
+        auto detach() noexcept -> Socket
+            { return std::move(m_socket); }
+
+        explicit operator bool() const noexcept 
+            { return bool(m_socket); }
+    private:
+        Socket m_socket;
+    };
+
+    #endif
+
+    #if defined(__linux__) && defined(TCP_ULP) && defined(SOL_TLS) && defined(TLS_SET_RECORD_TYPE) && defined(TLS_CIPHER_CHACHA20_POLY1305)
+
+    namespace impl {
+        template<class Info> struct TlsCipherType;
+        template<> struct TlsCipherType<::tls12_crypto_info_aes_gcm_128> 
+            { static constexpr uint16_t value = TLS_CIPHER_AES_GCM_128; };
+        template<> struct TlsCipherType<::tls12_crypto_info_aes_gcm_256> 
+            { static constexpr uint16_t value = TLS_CIPHER_AES_GCM_256; };
+        template<> struct TlsCipherType<::tls12_crypto_info_chacha20_poly1305> 
+            { static constexpr uint16_t value = TLS_CIPHER_CHACHA20_POLY1305; };
+    }
+
+    //crypto info structures accepted by SockOptTlsTx and SockOptTlsRx
+    template<class Info>
+    concept TlsCryptoInfo = requires { impl::TlsCipherType<Info>::value; };
+
+    //SOL_TLS options. They are only available after enableKernelTls()
+    constexpr auto SockOptTlsTx                 = SockOptDesc<::tls12_crypto_info_aes_gcm_128,
+                                                              ::tls12_crypto_info_aes_gcm_256,
+                                                              ::tls12_crypto_info_chacha20_poly1305> {SOL_TLS, TLS_TX};
+    constexpr auto SockOptTlsRx                 = SockOptDesc<::tls12_crypto_info_aes_gcm_128,
+                                                              ::tls12_crypto_info_aes_gcm_256,
+                                                              ::tls12_crypto_info_chacha20_poly1305> {SOL_TLS, TLS_RX};
+    #ifdef TLS_TX_ZEROCOPY_RO
+        constexpr auto SockOptTlsTxZeroCopy     = SockOptDesc<bool>         {SOL_TLS, TLS_TX_ZEROCOPY_RO};
+    #endif
+    #ifdef TLS_RX_EXPECT_NO_PAD
+        constexpr auto SockOptTlsRxExpectNoPad  = SockOptDesc<bool>         {SOL_TLS, TLS_RX_EXPECT_NO_PAD};
+    #endif
+
+    constexpr uint16_t TlsVersion12 = TLS_1_2_VERSION;
+    constexpr uint16_t TlsVersion13 = TLS_1_3_VERSION;
+
+    enum class TlsRecordType : uint8_t {
+        ChangeCipherSpec    = 20,
+        Alert               = 21,
+        Handshake           = 22,
+        ApplicationData     = 23
+    };
+
+    //Builds crypto info for one direction from the traffic secrets negotiated by a TLS library.
+    //For AES-GCM salt is the 4 byte implicit part of the nonce and iv the 8 byte explicit part.
+    //For ChaCha20-Poly1305 iv is the full 12 byte nonce and salt is empty.
+    template<TlsCryptoInfo Info>
+    inline auto makeTlsCryptoInfo(uint16_t version, 
+                                  std::span<const uint8_t> key, std::span<const uint8_t> iv, std::span<const uint8_t> salt,
+                                  std::span<const uint8_t> recordSequence) -> Info {
+        Info ret{};
+        if (key.size() != sizeof(ret.key) || iv.size() != sizeof(ret.iv) || salt.size() != sizeof(ret.salt) ||
+            recordSequence.size() != sizeof(ret.rec_seq))
+            throwErrorCode(EINVAL, "TLS cipher {} requires key, iv, salt and sequence of sizes {}, {}, {}, {}", 
+                           impl::TlsCipherType<Info>::value, sizeof(ret.key), sizeof(ret.iv), sizeof(ret.salt), sizeof(ret.rec_seq));
+        ret.info.version = version;
+        ret.info.cipher_type = impl::TlsCipherType<Info>::value;
+        std::copy(key.begin(), key.end(), ret.key);
+        std::copy(iv.begin(), iv.end(), ret.iv);
+        std::copy(salt.begin(), salt.end(), ret.salt);
+        std::copy(recordSequence.begin(), recordSequence.end(), ret.rec_seq);
+        return ret;
+    }
+
+    //Attaches the kernel TLS upper layer protocol to a connected TCP socket. 
+    //Fails with ENOENT if the kernel lacks TLS support.
+    inline void enableKernelTls(SocketLike auto && socket,
+                                PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        setSocketOption(std::forward<decltype(socket)>(socket), SockOptTCPUlp, "tls", PTL_ERROR_REF(err));
+    }
+
+    //Sends data as a single TLS record of the given type, such as an alert or a TLS 1.3 
+    //key update handshake message.
+    inline auto sendTlsRecord(SocketLike auto && socket, TlsRecordType type, const void * buf, size_t length, int flags,
+                              PTL_ERROR_REF_ARG(err)) -> io_ssize_t
+    requires(PTL_ERROR_REQ(err)) {
+        MessageHeader<1, ControlMessageSpace<uint8_t>> msg;
+        msg.payload(buf, length);
+        msg.control(SOL_TLS, TLS_SET_RECORD_TYPE, uint8_t(type));
+        return sendSocket(std::forward<decltype(socket)>(socket), msg, flags, PTL_ERROR_REF(err));
+    }
+
+    struct TlsReceived {
+        io_ssize_t size = -1;
+        TlsRecordType type = TlsRecordType::ApplicationData;
+    };
+
+    //Receives data from one TLS record together with its type. Plain receiveSocket fails with EIO
+    //when the next record is not application data so such records must be read with this call.
+    inline auto receiveTlsRecord(SocketLike auto && socket, void * buf, size_t length, int flags,
+                                 PTL_ERROR_REF_ARG(err)) -> TlsReceived
+    requires(PTL_ERROR_REQ(err)) {
+        MessageHeader<1, ControlMessageSpace<uint8_t>> msg;
+        msg.payload(buf, length);
+        TlsReceived ret;
+        ret.size = receiveSocket(std::forward<decltype(socket)>(socket), msg, flags, PTL_ERROR_REF(err));
+        if (ret.size < 0)
+            return ret;
+        for (ControlMessage cmsg: msg.controlMessages()) {
+            if (!cmsg.is(SOL_TLS, TLS_GET_RECORD_TYPE))
+                continue;
+            if (auto type = cmsg.as<uint8_t>())
+                ret.type = TlsRecordType(*type);
+        }
+        return ret;
+    }
+
+    #endif
+
 }
 
+template<>
+struct std::hash<ptl::SocketAddress> {
+    auto operator()(const ptl::SocketAddress & addr) const noexcept -> size_t
+        { return addr.hash(); }
+};
+
+#if PTL_USE_STD_FORMAT
+template<>
+struct std::formatter<ptl::SocketAddress> : std::formatter<std::string_view> {
+#else
+template<>
+struct fmt::formatter<ptl::SocketAddress> : fmt::formatter<std::string_view> {
+#endif
+    template<class FormatContext>
+    auto format(const ptl::SocketAddress & addr, FormatContext & ctx) const {
+        char buf[ptl::SocketAddress::maxTextLength];
+        auto end = addr.formatTo(buf);
+        return formatter<std::string_view>::format(std::string_view(buf, size_t(end - buf)), ctx);
+    }
+};
+
 #endif
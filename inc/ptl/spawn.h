@@ -12,11 +12,37 @@
 #include <cassert>
 #include <optional>
 #include <iterator>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
 
 #if __has_include(<spawn.h>)
     #include <spawn.h>
 #endif
 
+#if PTL_HAVE_VFORK && !defined(__APPLE__)
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <signal.h>
+    #include <string.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__APPLE__)
+    #include <crt_externs.h>
+#elif !defined(_WIN32)
+    extern "C" {
+        extern char ** environ;
+    }
+#endif
+
 
 namespace ptl::inline v0 {
 
@@ -37,7 +63,22 @@ namespace ptl::inline v0 {
     #if !defined(__ANDROID__) || (defined(__ANDROID__) && __ANDROID_API__ >= 28)
 
     #ifndef _WIN32
+
+    namespace impl {
+        //a file action as replayed by the vfork backend
+        struct SpawnFileAction {
+            enum Kind { Close, Open, Duplicate, Chdir, CloseFrom };
+
+            Kind kind;
+            int fd;
+            int arg = 0;        //target descriptor for Duplicate, flags for Open
+            mode_t mode = 0;
+            std::string path = {};
+        };
+    }
+
     class SpawnFileActions {
+    friend class SpawnSettings;
     public:
         SpawnFileActions() 
             { posixCheck(posix_spawn_file_actions_init(&m_wrapped), "posix_spawn_file_actions_init failed"); }
@@ -50,25 +91,30 @@ namespace ptl::inline v0 {
             { return &m_wrapped; }
 
         void addClose(FileDescriptorLike auto && fd) {
-            posixCheck(posix_spawn_file_actions_addclose(&m_wrapped, 
-                                                         c_fd(std::forward<decltype(fd)>(fd))),
+            int desc = c_fd(std::forward<decltype(fd)>(fd));
+            posixCheck(posix_spawn_file_actions_addclose(&m_wrapped, desc),
                        "posix_spawn_file_actions_addclose failed");
+            m_recorded.push_back({.kind = impl::SpawnFileAction::Close, .fd = desc});
         }
 
         void addOpen(FileDescriptorLike auto && fd, PathLike auto && path, int oflag, mode_t mode) {
+            int desc = c_fd(std::forward<decltype(fd)>(fd));
+            const char * pathStr = c_path(std::forward<decltype(path)>(path));
             posixCheck(posix_spawn_file_actions_addopen(&m_wrapped, 
-                                                        c_fd(std::forward<decltype(fd)>(fd)),
-                                                        c_path(std::forward<decltype(path)>(path)),
+                                                        desc,
+                                                        pathStr,
                                                         oflag,
                                                         mode),
                        "posix_spawn_file_actions_addopen failed");
+            m_recorded.push_back({.kind = impl::SpawnFileAction::Open, .fd = desc, .arg = oflag, .mode = mode, .path = pathStr});
         }
 
         void addDuplicateTo(FileDescriptorLike auto && fdFrom, const FileDescriptorLike auto & fdTo) {
-            posixCheck(posix_spawn_file_actions_adddup2(&m_wrapped, 
-                                                        c_fd(std::forward<decltype(fdFrom)>(fdFrom)), 
-                                                        c_fd(std::forward<decltype(fdTo)>(fdTo))),
+            int from = c_fd(std::forward<decltype(fdFrom)>(fdFrom));
+            int to = c_fd(std::forward<decltype(fdTo)>(fdTo));
+            posixCheck(posix_spawn_file_actions_adddup2(&m_wrapped, from, to),
                        "posix_spawn_file_actions_adddup2 failed");
+            m_recorded.push_back({.kind = impl::SpawnFileAction::Duplicate, .fd = from, .arg = to});
         }
         
         #if PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDINHERIT_NP
@@ -81,23 +127,26 @@ namespace ptl::inline v0 {
 
         #if PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
         void addCloseFromNp(FileDescriptorLike auto && fd) {
-            posixCheck(posix_spawn_file_actions_addclosefrom_np(&m_wrapped, 
-                                                                c_fd(std::forward<decltype(fd)>(fd))),
+            int desc = c_fd(std::forward<decltype(fd)>(fd));
+            posixCheck(posix_spawn_file_actions_addclosefrom_np(&m_wrapped, desc),
                        "posix_spawn_file_actions_addclosefrom_np failed");
+            m_recorded.push_back({.kind = impl::SpawnFileAction::CloseFrom, .fd = desc});
         }
         #endif
 
         #if PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
         void addChdirNp(PathLike auto && path) {
-            posixCheck(posix_spawn_file_actions_addchdir_np(&m_wrapped, 
-                                                            c_path(std::forward<decltype(path)>(path))),
+            const char * pathStr = c_path(std::forward<decltype(path)>(path));
+            posixCheck(posix_spawn_file_actions_addchdir_np(&m_wrapped, pathStr),
                        "posix_spawn_file_actions_addchdir_np failed");
+            m_recorded.push_back({.kind = impl::SpawnFileAction::Chdir, .fd = -1, .path = pathStr});
         }
         #endif
         
         
     private:
         posix_spawn_file_actions_t m_wrapped;
+        std::vector<impl::SpawnFileAction> m_recorded;
     };
 
     class SpawnAttr {
@@ -126,6 +175,13 @@ namespace ptl::inline v0 {
     };
     #endif
 
+
+    #if PTL_HAVE_VFORK && !defined(__APPLE__)
+    enum class SpawnBackend {
+        PosixSpawn,     //posix_spawn or posix_spawnp
+        Vfork           //vfork and exec with file actions and attributes replayed by PTL
+    };
+    #endif
     
     class SpawnSettings {
 
@@ -133,10 +189,12 @@ namespace ptl::inline v0 {
         #ifndef _WIN32
         auto fileActions(const posix_spawn_file_actions_t * ptr) noexcept -> SpawnSettings & {
             m_fileActions = ptr;
+            m_recordedActions = nullptr;
             return *this;
         }
         auto fileActions(const SpawnFileActions & val) noexcept -> SpawnSettings & {
             m_fileActions = val.get();
+            m_recordedActions = &val.m_recorded;
             return *this;
         }
         auto fileActions(SpawnFileActions && val) = delete;
@@ -152,6 +210,13 @@ namespace ptl::inline v0 {
         auto attr(SpawnAttr && val) = delete;
         #endif
 
+        #if PTL_HAVE_VFORK && !defined(__APPLE__)
+        auto backend(SpawnBackend val) noexcept -> SpawnSettings & {
+            m_backend = val;
+            return *this;
+        }
+        #endif
+
         auto usePath() noexcept -> SpawnSettings & {
             #ifndef _WIN32
                 m_func = &::posix_spawnp;
@@ -161,9 +226,39 @@ namespace ptl::inline v0 {
             return *this;
         }
 
+        #if PTL_HAVE_PIDFD
+        //Opens a pidfd for each spawned child right after it is started. This is not atomic with the spawn
+        //and has the same caveat as ChildProcess::openPidfd when children are reaped automatically.
+        //If opening fails, for example on kernels before 5.3, the child is still returned but its pidfd() 
+        //is empty. Call ChildProcess::openPidfd to find out why.
+        auto openPidfd() noexcept -> SpawnSettings & {
+            m_openPidfd = true;
+            return *this;
+        }
+        #endif
+
         auto doSpawn(const char * path, const char * const * args, const char * const * env,
                      PTL_ERROR_REF_ARG(err)) const -> ChildProcess 
         requires(PTL_ERROR_REQ(err)) {
+            auto ret = spawnChild(path, args, env, PTL_ERROR_REF(err));
+            #if PTL_HAVE_PIDFD
+            //best effort: the spawn succeeded regardless and a failure shows as an empty pidfd()
+            if (m_openPidfd && ret) {
+                std::error_code ec;
+                ret.openPidfd(ec);
+            }
+            #endif
+            return ret;
+        }
+        
+    private:
+        auto spawnChild(const char * path, const char * const * args, const char * const * env,
+                        PTL_ERROR_REF_ARG(err)) const -> ChildProcess 
+        requires(PTL_ERROR_REQ(err)) {
+            #if PTL_HAVE_VFORK && !defined(__APPLE__)
+            if (m_backend == SpawnBackend::Vfork)
+                return vforkSpawn(path, args, env, PTL_ERROR_REF(err));
+            #endif
             pid_t childPid;
             #ifndef _WIN32
             int res = m_func(&childPid, 
@@ -188,15 +283,276 @@ namespace ptl::inline v0 {
             }
             return ChildProcess(childPid);
         }
-        
+
+        #if PTL_HAVE_VFORK && !defined(__APPLE__)
+
+        //Everything the child needs, prepared by the parent. The child shares the parent memory and
+        //may only make async-signal-safe calls.
+        struct VforkContext {
+            const char * const * candidates;
+            char * const * args;
+            char * const * env;
+            const impl::SpawnFileAction * actions;
+            size_t actionCount;
+            short flags;
+            sigset_t sigDefault;
+            sigset_t sigMask;
+            pid_t pgroup;
+            #ifdef POSIX_SPAWN_SETSCHEDULER
+            int schedPolicy;
+            sched_param schedParam;
+            #endif
+            int errorPipe;
+        };
+
+        [[noreturn]] static void vforkFail(int errorPipe, int code) noexcept {
+            while (::write(errorPipe, &code, sizeof(code)) < 0 && errno == EINTR)
+                ;
+            ::_exit(127);
+        }
+
+        //moves the error pipe out of the way of a descriptor an action is about to use
+        static auto vforkMovePipe(int errorPipe, int target) noexcept -> int {
+            if (errorPipe != target)
+                return errorPipe;
+            int ret = ::fcntl(errorPipe, F_DUPFD_CLOEXEC, target + 1);
+            if (ret < 0)
+                vforkFail(errorPipe, errno);
+            return ret;
+        }
+
+        static void vforkCloseFrom(int first, int errorPipe) noexcept {
+            #ifdef SYS_close_range
+            if (errorPipe < first) {
+                if (::syscall(SYS_close_range, unsigned(first), ~0u, 0u) == 0)
+                    return;
+            } else {
+                if ((errorPipe == first || ::syscall(SYS_close_range, unsigned(first), unsigned(errorPipe - 1), 0u) == 0) &&
+                    ::syscall(SYS_close_range, unsigned(errorPipe + 1), ~0u, 0u) == 0)
+                    return;
+            }
+            #endif
+            rlimit limit;
+            int last = ::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY ? int(limit.rlim_cur) : 65536;
+            for (int fd = first; fd < last; ++fd) {
+                if (fd != errorPipe)
+                    ::close(fd);
+            }
+        }
+
+        [[noreturn]] static void vforkChild(const VforkContext & ctx) noexcept {
+            int errorPipe = ctx.errorPipe;
+
+            //handlers installed by the parent must not run in the shared memory
+            for (int sig = 1; sig < NSIG; ++sig) {
+                struct sigaction action;
+                if (sig == SIGKILL || sig == SIGSTOP || ::sigaction(sig, nullptr, &action) != 0)
+                    continue;
+                bool reset = (ctx.flags & POSIX_SPAWN_SETSIGDEF) && sigismember(&ctx.sigDefault, sig);
+                if (reset || (action.sa_handler != SIG_IGN && action.sa_handler != SIG_DFL)) {
+                    action.sa_handler = SIG_DFL;
+                    action.sa_flags = 0;
+                    sigemptyset(&action.sa_mask);
+                    ::sigaction(sig, &action, nullptr);
+                }
+            }
+
+            #ifdef POSIX_SPAWN_SETSID
+            if ((ctx.flags & POSIX_SPAWN_SETSID) && ::setsid() < 0)
+                vforkFail(errorPipe, errno);
+            #endif
+            if ((ctx.flags & POSIX_SPAWN_SETPGROUP) && ::setpgid(0, ctx.pgroup) != 0)
+                vforkFail(errorPipe, errno);
+            #ifdef POSIX_SPAWN_SETSCHEDULER
+            if (ctx.flags & POSIX_SPAWN_SETSCHEDULER) {
+                if (::sched_setscheduler(0, ctx.schedPolicy, &ctx.schedParam) < 0)
+                    vforkFail(errorPipe, errno);
+            } else if ((ctx.flags & POSIX_SPAWN_SETSCHEDPARAM) && ::sched_setparam(0, &ctx.schedParam) != 0) {
+                vforkFail(errorPipe, errno);
+            }
+            #endif
+            if (ctx.flags & POSIX_SPAWN_RESETIDS) {
+                //the libc wrappers would try to change the ids of all the parent threads
+                #if defined(__linux__)
+                    if (::syscall(SYS_setgid, ::getgid()) != 0 || ::syscall(SYS_setuid, ::getuid()) != 0)
+                #else
+                    if (::setgid(::getgid()) != 0 || ::setuid(::getuid()) != 0)
+                #endif
+                    vforkFail(errorPipe, errno);
+            }
+
+            for (size_t i = 0; i < ctx.actionCount; ++i) {
+                auto & action = ctx.actions[i];
+                switch(action.kind) {
+                case impl::SpawnFileAction::Close:
+                    //the error pipe is not something the caller could have meant
+                    if (action.fd != errorPipe && ::close(action.fd) != 0 && errno != EBADF)
+                        vforkFail(errorPipe, errno);
+                    break;
+                case impl::SpawnFileAction::Open: {
+                    errorPipe = vforkMovePipe(errorPipe, action.fd);
+                    int fd = ::open(action.path.c_str(), action.arg, action.mode);
+                    if (fd < 0)
+                        vforkFail(errorPipe, errno);
+                    if (fd != action.fd) {
+                        if (::dup2(fd, action.fd) < 0)
+                            vforkFail(errorPipe, errno);
+                        ::close(fd);
+                    }
+                    break;
+                }
+                case impl::SpawnFileAction::Duplicate:
+                    if (action.fd == errorPipe)
+                        vforkFail(errorPipe, EBADF);
+                    if (action.fd == action.arg) {
+                        //like posix_spawn, make a descriptor duplicated onto itself inheritable
+                        int flags = ::fcntl(action.fd, F_GETFD);
+                        if (flags < 0 || ::fcntl(action.fd, F_SETFD, flags & ~FD_CLOEXEC) < 0)
+                            vforkFail(errorPipe, errno);
+                    } else {
+                        errorPipe = vforkMovePipe(errorPipe, action.arg);
+                        if (::dup2(action.fd, action.arg) < 0)
+                            vforkFail(errorPipe, errno);
+                    }
+                    break;
+                case impl::SpawnFileAction::Chdir:
+                    if (::chdir(action.path.c_str()) != 0)
+                        vforkFail(errorPipe, errno);
+                    break;
+                case impl::SpawnFileAction::CloseFrom:
+                    vforkCloseFrom(action.fd, errorPipe);
+                    break;
+                }
+            }
+
+            ::sigprocmask(SIG_SETMASK, &ctx.sigMask, nullptr);
+
+            //same rules as execvp: keep looking past missing and inaccessible candidates
+            bool sawAccessError = false;
+            for (auto candidate = ctx.candidates; *candidate; ++candidate) {
+                ::execve(*candidate, ctx.args, ctx.env);
+                int code = errno;
+                if (code == EACCES)
+                    sawAccessError = true;
+                else if (code != ENOENT && code != ENOTDIR && code != ESTALE && code != ENODEV && code != ETIMEDOUT)
+                    vforkFail(errorPipe, code);
+            }
+            vforkFail(errorPipe, sawAccessError ? EACCES : ENOENT);
+        }
+
+        [[gnu::noinline]] static auto vforkStart(const VforkContext & ctx) noexcept -> pid_t {
+            pid_t pid = ::vfork();
+            if (pid == 0)
+                vforkChild(ctx);
+            return pid;
+        }
+
+        auto vforkSpawn(const char * path, const char * const * args, const char * const * env,
+                        PTL_ERROR_REF_ARG(err)) const -> ChildProcess 
+        requires(PTL_ERROR_REQ(err)) {
+            if (m_fileActions && !m_recordedActions)
+                throwErrorCode(EINVAL, "vfork spawn backend requires SpawnFileActions rather than raw posix_spawn_file_actions_t");
+
+            VforkContext ctx{};
+            ctx.args = const_cast<char * const *>(args);
+            ctx.env = const_cast<char * const *>(env);
+            if (m_recordedActions) {
+                ctx.actions = m_recordedActions->data();
+                ctx.actionCount = m_recordedActions->size();
+            }
+            sigemptyset(&ctx.sigDefault);
+            if (m_attr) {
+                posixCheck(posix_spawnattr_getflags(m_attr, &ctx.flags), "posix_spawnattr_getflags failed");
+                posixCheck(posix_spawnattr_getsigdefault(m_attr, &ctx.sigDefault), "posix_spawnattr_getsigdefault failed");
+                posixCheck(posix_spawnattr_getpgroup(m_attr, &ctx.pgroup), "posix_spawnattr_getpgroup failed");
+                #ifdef POSIX_SPAWN_SETSCHEDULER
+                posixCheck(posix_spawnattr_getschedpolicy(m_attr, &ctx.schedPolicy), "posix_spawnattr_getschedpolicy failed");
+                posixCheck(posix_spawnattr_getschedparam(m_attr, &ctx.schedParam), "posix_spawnattr_getschedparam failed");
+                #endif
+            }
+
+            //PATH search happens here since the child cannot allocate
+            std::vector<std::string> candidateStore;
+            std::vector<const char *> candidates;
+            if (m_func == &::posix_spawnp && !strchr(path, '/') && *path) {
+                const char * searchPath = ::getenv("PATH");
+                std::string_view dirs = searchPath ? searchPath : "/bin:/usr/bin";
+                for (size_t pos = 0; ; ) {
+                    auto next = dirs.find(':', pos);
+                    auto dir = dirs.substr(pos, next == dirs.npos ? dirs.npos : next - pos);
+                    std::string candidate(dir);
+                    if (!candidate.empty())
+                        candidate += '/';
+                    candidate += path;
+                    candidateStore.push_back(std::move(candidate));
+                    if (next == dirs.npos)
+                        break;
+                    pos = next + 1;
+                }
+                for (auto & candidate: candidateStore)
+                    candidates.push_back(candidate.c_str());
+            } else {
+                candidates.push_back(path);
+            }
+            candidates.push_back(nullptr);
+            ctx.candidates = candidates.data();
+
+            int fds[2];
+            if (::pipe2(fds, O_CLOEXEC) != 0) {
+                handleError(PTL_ERROR_REF(err), errno, "pipe2() failed");
+                return ChildProcess();
+            }
+            FileDescriptor readEnd(fds[0]), writeEnd(fds[1]);
+            ctx.errorPipe = writeEnd.get();
+
+            //no signal handler may run in the child before it resets them
+            sigset_t all;
+            sigfillset(&all);
+            ::pthread_sigmask(SIG_SETMASK, &all, &ctx.sigMask);
+            sigset_t original = ctx.sigMask;
+            if (m_attr && (ctx.flags & POSIX_SPAWN_SETSIGMASK))
+                posix_spawnattr_getsigmask(m_attr, &ctx.sigMask);
+
+            pid_t pid = vforkStart(ctx);
+            int forkError = errno;
+            ::pthread_sigmask(SIG_SETMASK, &original, nullptr);
+            writeEnd.close();
+            if (pid < 0) {
+                handleError(PTL_ERROR_REF(err), forkError, "vfork() failed");
+                return ChildProcess();
+            }
+
+            //the pipe is closed on successful exec, otherwise the child sends its errno
+            int code = 0;
+            ssize_t res;
+            while ((res = ::read(readEnd.get(), &code, sizeof(code))) < 0 && errno == EINTR)
+                ;
+            if (res == ssize_t(sizeof(code))) {
+                ChildProcess failed(pid);
+                failed.wait();
+                handleError(PTL_ERROR_REF(err), code, "cannot spawn {}", path);
+                return ChildProcess();
+            }
+            clearError(PTL_ERROR_REF(err));
+            return ChildProcess(pid);
+        }
+        #endif
+
     private:
         #ifndef _WIN32
             decltype(::posix_spawn) * m_func = &::posix_spawn;
             const posix_spawn_file_actions_t * m_fileActions = nullptr;
+            const std::vector<impl::SpawnFileAction> * m_recordedActions = nullptr;
             const posix_spawnattr_t * m_attr = nullptr;
         #else
             decltype(::_spawnve) * m_func = &::_spawnve;
         #endif
+        #if PTL_HAVE_VFORK && !defined(__APPLE__)
+            SpawnBackend m_backend = SpawnBackend::PosixSpawn;
+        #endif
+        #if PTL_HAVE_PIDFD
+            bool m_openPidfd = false;
+        #endif
     };
 
     
@@ -260,6 +616,236 @@ namespace ptl::inline v0 {
         return spawn(args[0], args, {}, PTL_ERROR_REF(err));
     }
 
+    #ifndef _WIN32
+
+    struct SpawnLatencyStatistics {
+        //successful launches the statistics are based on
+        size_t count = 0;
+        std::chrono::nanoseconds min{};
+        std::chrono::nanoseconds max{};
+        std::chrono::nanoseconds mean{};
+        std::chrono::nanoseconds median{};
+        std::chrono::nanoseconds p99{};
+        //wall clock time of the whole batch
+        std::chrono::nanoseconds elapsed{};
+    };
+
+    struct SpawnBatch {
+        //empty ChildProcess where the launch failed
+        std::vector<ChildProcess> children;
+        //errno value of each launch or 0
+        std::vector<int> errors;
+        SpawnLatencyStatistics statistics;
+    };
+
+    //Executable, file actions, attributes and environment prepared once for spawning
+    //many similar children. Spawning does not modify the template and can be done from 
+    //several threads at once.
+    class SpawnTemplate {
+    public:
+        //The environment is a copy of the current process one
+        explicit SpawnTemplate(PathLike auto && exe) :
+            m_exe(c_path(std::forward<decltype(exe)>(exe))) {
+            #ifdef __APPLE__
+                auto env = *_NSGetEnviron();
+            #else
+                auto env = ::environ;
+            #endif
+            for ( ; env && *env; ++env)
+                m_env.emplace_back(*env);
+            updateEnvironment();
+            m_settings.fileActions(m_fileActions).attr(m_attr);
+        }
+        SpawnTemplate(PathLike auto && exe, StringLikeArray auto && env) :
+            m_exe(c_path(std::forward<decltype(exe)>(exe))) {
+            setEnvironment(std::forward<decltype(env)>(env));
+            m_settings.fileActions(m_fileActions).attr(m_attr);
+        }
+        SpawnTemplate(const SpawnTemplate &) = delete;
+        SpawnTemplate & operator=(const SpawnTemplate &) = delete;
+
+        auto fileActions() noexcept -> SpawnFileActions &
+            { return m_fileActions; }
+        auto attr() noexcept -> SpawnAttr &
+            { return m_attr; }
+        auto usePath() noexcept -> SpawnTemplate & {
+            m_settings.usePath();
+            return *this;
+        }
+        #if PTL_HAVE_VFORK && !defined(__APPLE__)
+        auto backend(SpawnBackend val) noexcept -> SpawnTemplate & {
+            m_settings.backend(val);
+            return *this;
+        }
+        #endif
+        #if PTL_HAVE_PIDFD
+        auto openPidfd() noexcept -> SpawnTemplate & {
+            m_settings.openPidfd();
+            return *this;
+        }
+        #endif
+
+        void setEnvironment(StringLikeArray auto && env) {
+            m_env.clear();
+            for (auto && str: env)
+                m_env.emplace_back(c_str(str));
+            updateEnvironment();
+        }
+        auto environment() const noexcept -> const char * const *
+            { return m_envPointers.data(); }
+
+        auto spawn(const StringRefArray & args,
+                   PTL_ERROR_REF_ARG(err)) const -> ChildProcess
+        requires(PTL_ERROR_REQ(err)) {
+            return m_settings.doSpawn(m_exe.c_str(), args.data(), m_envPointers.data(), PTL_ERROR_REF(err));
+        }
+
+        //envOverrides are NAME=value strings that replace or add to the template environment, 
+        //or bare NAME strings that remove NAME from it
+        auto spawn(const StringRefArray & args, const StringRefArray & envOverrides,
+                   PTL_ERROR_REF_ARG(err)) const -> ChildProcess
+        requires(PTL_ERROR_REQ(err)) {
+            auto env = mergeEnvironment(envOverrides);
+            return m_settings.doSpawn(m_exe.c_str(), args.data(), env.data(), PTL_ERROR_REF(err));
+        }
+
+        //Spawns a child for each element of args using up to threads threads.
+        //Launch failures are reported per child in the result rather than as errors.
+        template<std::ranges::random_access_range Args>
+        requires(StringLikeArray<std::ranges::range_reference_t<const Args>>)
+        auto spawnBatch(const Args & args, unsigned threads = 1) const -> SpawnBatch {
+            return doBatch(size_t(std::ranges::size(args)), threads, [&](size_t idx, std::error_code & ec) {
+                return spawn(std::ranges::begin(args)[std::ranges::range_difference_t<const Args>(idx)], ec);
+            });
+        }
+
+        template<std::ranges::random_access_range Args, std::ranges::random_access_range Envs>
+        requires(StringLikeArray<std::ranges::range_reference_t<const Args>> && 
+                 StringLikeArray<std::ranges::range_reference_t<const Envs>>)
+        auto spawnBatch(const Args & args, const Envs & envOverrides, unsigned threads = 1) const -> SpawnBatch {
+            const auto count = size_t(std::ranges::size(args));
+            if (size_t(std::ranges::size(envOverrides)) != count)
+                throwErrorCode(EINVAL, "{} environment overrides for {} children", std::ranges::size(envOverrides), count);
+            return doBatch(count, threads, [&](size_t idx, std::error_code & ec) {
+                return spawn(std::ranges::begin(args)[std::ranges::range_difference_t<const Args>(idx)], 
+                             std::ranges::begin(envOverrides)[std::ranges::range_difference_t<const Envs>(idx)], ec);
+            });
+        }
+
+    private:
+        void updateEnvironment() {
+            m_envPointers.clear();
+            m_envPointers.reserve(m_env.size() + 1);
+            for (auto & str: m_env)
+                m_envPointers.push_back(str.c_str());
+            m_envPointers.push_back(nullptr);
+        }
+
+        auto mergeEnvironment(const StringRefArray & overrides) const -> std::vector<const char *> {
+            auto ret = m_envPointers;
+            ret.pop_back();
+            for (auto ptr = overrides.data(); *ptr; ++ptr) {
+                std::string_view item(*ptr);
+                auto assignment = item.find('=');
+                auto name = item.substr(0, assignment);
+                if (name.empty())
+                    throwErrorCode(EINVAL, "invalid environment override \"{}\"", item);
+                auto it = std::find_if(ret.begin(), ret.end(), [&](const char * existing) {
+                    std::string_view entry(existing);
+                    return entry.size() > name.size() && entry.starts_with(name) && entry[name.size()] == '=';
+                });
+                if (assignment == std::string_view::npos) {
+                    //a bare NAME removes the variable
+                    if (it != ret.end())
+                        ret.erase(it);
+                } else if (it != ret.end()) {
+                    *it = *ptr;
+                } else {
+                    ret.push_back(*ptr);
+                }
+            }
+            ret.push_back(nullptr);
+            return ret;
+        }
+
+        template<class Func>
+        static auto doBatch(size_t count, unsigned threads, Func spawnOne) -> SpawnBatch {
+            using Clock = std::chrono::steady_clock;
+
+            SpawnBatch ret;
+            ret.children.resize(count);
+            ret.errors.resize(count);
+            std::vector<std::chrono::nanoseconds> latencies(count);
+            std::vector<std::exception_ptr> failures(std::max(threads, 1u));
+            std::atomic<size_t> next{0};
+
+            auto worker = [&](unsigned threadIdx) {
+                try {
+                    for (size_t idx; (idx = next.fetch_add(1, std::memory_order_relaxed)) < count; ) {
+                        std::error_code ec;
+                        auto start = Clock::now();
+                        auto child = spawnOne(idx, ec);
+                        latencies[idx] = Clock::now() - start;
+                        ret.children[idx] = std::move(child);
+                        ret.errors[idx] = ec.value();
+                    }
+                } catch(...) {
+                    failures[threadIdx] = std::current_exception();
+                    next.store(count, std::memory_order_relaxed);
+                }
+            };
+
+            const auto start = Clock::now();
+            std::vector<std::thread> pool;
+            try {
+                for (unsigned i = 1; i < threads && i < count; ++i)
+                    pool.emplace_back(worker, i);
+            } catch(...) {
+                failures[0] = std::current_exception();
+                next.store(count, std::memory_order_relaxed);
+            }
+            if (!failures[0])
+                worker(0);
+            for (auto & thread: pool)
+                thread.join();
+            ret.statistics.elapsed = Clock::now() - start;
+            for (auto & failure: failures) {
+                if (failure)
+                    std::rethrow_exception(failure);
+            }
+
+            std::vector<std::chrono::nanoseconds> succeeded;
+            succeeded.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                if (ret.errors[i] == 0)
+                    succeeded.push_back(latencies[i]);
+            }
+            if (!succeeded.empty()) {
+                std::sort(succeeded.begin(), succeeded.end());
+                auto & stats = ret.statistics;
+                stats.count = succeeded.size();
+                stats.min = succeeded.front();
+                stats.max = succeeded.back();
+                std::chrono::nanoseconds total{};
+                for (auto latency: succeeded)
+                    total += latency;
+                stats.mean = total / int64_t(stats.count);
+                stats.median = succeeded[stats.count / 2];
+                stats.p99 = succeeded[std::min(stats.count - 1, stats.count * 99 / 100)];
+            }
+            return ret;
+        }
+    private:
+        std::string m_exe;
+        SpawnFileActions m_fileActions;
+        SpawnAttr m_attr;
+        SpawnSettings m_settings;
+        std::vector<std::string> m_env;
+        std::vector<const char *> m_envPointers;
+    };
+
+    #endif
+
     #endif //ANDROID version check
 
 #pragma endregion
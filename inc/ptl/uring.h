@@ -0,0 +1,454 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef PTL_HEADER_URING_H_INCLUDED
+#define PTL_HEADER_URING_H_INCLUDED
+
+#include <ptl/core.h>
+#include <ptl/file.h>
+#include <ptl/socket.h>
+
+#if __has_include(<linux/io_uring.h>) && __has_include(<sys/syscall.h>)
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+#endif
+
+#include <atomic>
+#include <optional>
+#include <span>
+
+//multishot receive is the newest facility used here, it implies provided buffer rings
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+
+namespace ptl::inline v0 {
+
+    namespace impl {
+        inline int ioUringSetup(unsigned entries, io_uring_params * params) noexcept
+            { return int(::syscall(__NR_io_uring_setup, entries, params)); }
+        inline int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) noexcept
+            { return int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0)); }
+        inline int ioUringRegister(int fd, unsigned opcode, void * arg, unsigned count) noexcept
+            { return int(::syscall(__NR_io_uring_register, fd, opcode, arg, count)); }
+    }
+
+    struct UringCompletion {
+        uint64_t userData;
+        int32_t result;
+        uint32_t flags;
+
+        //the multishot request that produced this completion is still active
+        auto more() const noexcept -> bool
+            { return flags & IORING_CQE_F_MORE; }
+        auto bufferId() const noexcept -> std::optional<uint16_t> {
+            if (flags & IORING_CQE_F_BUFFER)
+                return uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+            return std::nullopt;
+        }
+        //errno value of a failed request or 0
+        auto error() const noexcept -> int
+            { return result < 0 ? -result : 0; }
+    };
+
+    //A single-threaded io_uring instance with its submission and completion queues mapped.
+    class IoUring {
+    public:
+        IoUring() noexcept = default;
+
+        static auto create(unsigned entries, uint32_t setupFlags,
+                           PTL_ERROR_REF_ARG(err)) -> IoUring
+        requires(PTL_ERROR_REQ(err)) {
+            io_uring_params params{};
+            params.flags = setupFlags;
+            IoUring ret;
+            ret.m_fd = FileDescriptor(impl::ioUringSetup(entries, &params));
+            if (!ret.m_fd) {
+                handleError(PTL_ERROR_REF(err), errno, "io_uring_setup({}) failed", entries);
+                return ret;
+            }
+
+            size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (singleMap)
+                sqSize = cqSize = std::max(sqSize, cqSize);
+
+            constexpr int prot = PROT_READ | PROT_WRITE;
+            constexpr int flags = MAP_SHARED | MAP_POPULATE;
+            ret.m_sqRing = MemoryMap(sqSize, prot, flags, ret.m_fd, off_t(IORING_OFF_SQ_RING), PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return IoUring();
+            if (!singleMap) {
+                ret.m_cqRing = MemoryMap(cqSize, prot, flags, ret.m_fd, off_t(IORING_OFF_CQ_RING), PTL_ERROR_REF(err));
+                if (failed(PTL_ERROR_REF(err)))
+                    return IoUring();
+            }
+            ret.m_sqeMap = MemoryMap(params.sq_entries * sizeof(io_uring_sqe), prot, flags, ret.m_fd, off_t(IORING_OFF_SQES), PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return IoUring();
+
+            auto sq = static_cast<std::byte *>(ret.m_sqRing.data());
+            auto cq = singleMap ? sq : static_cast<std::byte *>(ret.m_cqRing.data());
+            ret.m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            ret.m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            ret.m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            ret.m_sqEntries = params.sq_entries;
+            ret.m_sqes = static_cast<io_uring_sqe *>(ret.m_sqeMap.data());
+            ret.m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            ret.m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            ret.m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            ret.m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            ret.m_sqLocalTail = *ret.m_sqTail;
+            //submission entries are always used in ring order
+            auto array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            for (unsigned i = 0; i < params.sq_entries; ++i)
+                array[i] = i;
+
+            clearError(PTL_ERROR_REF(err));
+            return ret;
+        }
+
+        static auto create(unsigned entries,
+                           PTL_ERROR_REF_ARG(err)) -> IoUring
+        requires(PTL_ERROR_REQ(err)) {
+            return create(entries, 0, PTL_ERROR_REF(err));
+        }
+
+        auto fd() const noexcept -> const FileDescriptor &
+            { return m_fd; }
+
+        explicit operator bool() const noexcept
+            { return bool(m_fd); }
+
+        //next free submission entry, zeroed, or nullptr if the queue is full
+        auto getSubmission() noexcept -> io_uring_sqe * {
+            unsigned head = std::atomic_ref(*m_sqHead).load(std::memory_order_acquire);
+            if (m_sqLocalTail - head >= m_sqEntries)
+                return nullptr;
+            auto sqe = &m_sqes[m_sqLocalTail & m_sqMask];
+            ++m_sqLocalTail;
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        //number of entries obtained via getSubmission() and not yet submitted
+        auto queued() const noexcept -> unsigned
+            { return m_sqLocalTail - std::atomic_ref(*m_sqHead).load(std::memory_order_acquire); }
+
+        //submits queued entries and waits until at least waitFor completions are available
+        auto submit(unsigned waitFor,
+                    PTL_ERROR_REF_ARG(err)) -> unsigned
+        requires(PTL_ERROR_REQ(err)) {
+            std::atomic_ref(*m_sqTail).store(m_sqLocalTail, std::memory_order_release);
+            int res;
+            do {
+                res = impl::ioUringEnter(m_fd.get(), queued(), waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0);
+            } while (res < 0 && errno == EINTR);
+            if (res < 0) {
+                handleError(PTL_ERROR_REF(err), errno, "io_uring_enter({}) failed", m_fd.get());
+                return 0;
+            }
+            clearError(PTL_ERROR_REF(err));
+            return unsigned(res);
+        }
+
+        //calls func(const UringCompletion &) for every available completion and returns their number
+        template<class Func>
+        auto processCompletions(Func && func) -> size_t {
+            unsigned head = *m_cqHead;
+            const unsigned tail = std::atomic_ref(*m_cqTail).load(std::memory_order_acquire);
+            size_t count = 0;
+            while (head != tail) {
+                auto & cqe = m_cqes[head & m_cqMask];
+                UringCompletion completion{cqe.user_data, cqe.res, cqe.flags};
+                //release the slot first so that func can safely throw
+                std::atomic_ref(*m_cqHead).store(++head, std::memory_order_release);
+                ++count;
+                func(completion);
+            }
+            return count;
+        }
+
+        void registerRaw(unsigned opcode, void * arg, unsigned count,
+                         PTL_ERROR_REF_ARG(err))
+        requires(PTL_ERROR_REQ(err)) {
+            if (impl::ioUringRegister(m_fd.get(), opcode, arg, count) != 0)
+                handleError(PTL_ERROR_REF(err), errno, "io_uring_register({}, {}) failed", m_fd.get(), opcode);
+            else
+                clearError(PTL_ERROR_REF(err));
+        }
+    private:
+        FileDescriptor m_fd;
+        MemoryMap m_sqRing;
+        MemoryMap m_cqRing;
+        MemoryMap m_sqeMap;
+        unsigned * m_sqHead = nullptr;
+        unsigned * m_sqTail = nullptr;
+        unsigned m_sqMask = 0;
+        unsigned m_sqEntries = 0;
+        unsigned m_sqLocalTail = 0;
+        io_uring_sqe * m_sqes = nullptr;
+        unsigned * m_cqHead = nullptr;
+        unsigned * m_cqTail = nullptr;
+        unsigned m_cqMask = 0;
+        io_uring_cqe * m_cqes = nullptr;
+    };
+
+    //A group of equally sized buffers the kernel picks from when a receive completes.
+    //Must be destroyed before the IoUring it is registered with.
+    class ProvidedBufferRing {
+    public:
+        ProvidedBufferRing() noexcept = default;
+
+        //count must be a power of 2 not exceeding 32768
+        static auto create(IoUring & ring, uint16_t groupId, unsigned count, size_t bufferSize,
+                           PTL_ERROR_REF_ARG(err)) -> ProvidedBufferRing
+        requires(PTL_ERROR_REQ(err)) {
+            if (count == 0 || count > 32768 || (count & (count - 1)) != 0)
+                throwErrorCode(EINVAL, "provided buffer ring size {} is not a power of 2 up to 32768", count);
+            if (bufferSize == 0 || bufferSize > std::numeric_limits<uint32_t>::max())
+                throwErrorCode(EINVAL, "invalid provided buffer size {}", bufferSize);
+
+            ProvidedBufferRing ret;
+            constexpr int prot = PROT_READ | PROT_WRITE;
+            constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+            ret.m_entries = MemoryMap(count * sizeof(io_uring_buf), prot, flags, -1, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+            ret.m_buffers = MemoryMap(count * bufferSize, prot, flags, -1, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+
+            io_uring_buf_reg reg{};
+            reg.ring_addr = reinterpret_cast<uintptr_t>(ret.m_entries.data());
+            reg.ring_entries = count;
+            reg.bgid = groupId;
+            ring.registerRaw(IORING_REGISTER_PBUF_RING, &reg, 1, PTL_ERROR_REF(err));
+            if (failed(PTL_ERROR_REF(err)))
+                return {};
+
+            ret.m_ringFd = ring.fd().get();
+            ret.m_groupId = groupId;
+            ret.m_mask = uint16_t(count - 1);
+            ret.m_bufferSize = bufferSize;
+            for (unsigned i = 0; i < count; ++i)
+                ret.add(uint16_t(i));
+            ret.publish();
+            return ret;
+        }
+
+        ~ProvidedBufferRing() noexcept {
+            if (m_ringFd >= 0) {
+                io_uring_buf_reg reg{};
+                reg.bgid = m_groupId;
+                impl::ioUringRegister(m_ringFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            }
+        }
+        ProvidedBufferRing(ProvidedBufferRing && src) noexcept :
+            m_entries(std::move(src.m_entries)),
+            m_buffers(std::move(src.m_buffers)),
+            m_ringFd(std::exchange(src.m_ringFd, -1)),
+            m_groupId(src.m_groupId),
+            m_mask(src.m_mask),
+            m_tail(src.m_tail),
+            m_bufferSize(src.m_bufferSize)
+        {}
+        ProvidedBufferRing & operator=(ProvidedBufferRing src) noexcept {
+            swap(src, *this);
+            return *this;
+        }
+        friend void swap(ProvidedBufferRing & lhs, ProvidedBufferRing & rhs) noexcept {
+            swap(lhs.m_entries, rhs.m_entries);
+            swap(lhs.m_buffers, rhs.m_buffers);
+            std::swap(lhs.m_ringFd, rhs.m_ringFd);
+            std::swap(lhs.m_groupId, rhs.m_groupId);
+            std::swap(lhs.m_mask, rhs.m_mask);
+            std::swap(lhs.m_tail, rhs.m_tail);
+            std::swap(lhs.m_bufferSize, rhs.m_bufferSize);
+        }
+
+        explicit operator bool() const noexcept
+            { return m_ringFd >= 0; }
+
+        auto groupId() const noexcept -> uint16_t
+            { return m_groupId; }
+        auto count() const noexcept -> size_t
+            { return m_ringFd >= 0 ? size_t(m_mask) + 1 : 0; }
+        auto bufferSize() const noexcept -> size_t
+            { return m_bufferSize; }
+        auto buffer(uint16_t id) const noexcept -> std::span<std::byte> {
+            assert(id <= m_mask);
+            return {static_cast<std::byte *>(m_buffers.data()) + size_t(id) * m_bufferSize, m_bufferSize};
+        }
+
+        //hands a buffer back to the kernel once its data has been consumed
+        void recycle(uint16_t id) noexcept {
+            add(id);
+            publish();
+        }
+        void recycle(std::span<const uint16_t> ids) noexcept {
+            for (auto id: ids)
+                add(id);
+            publish();
+        }
+    private:
+        void add(uint16_t id) noexcept {
+            assert(id <= m_mask);
+            auto & entry = static_cast<io_uring_buf *>(m_entries.data())[m_tail & m_mask];
+            entry.addr = reinterpret_cast<uintptr_t>(buffer(id).data());
+            entry.len = uint32_t(m_bufferSize);
+            entry.bid = id;
+            ++m_tail;
+        }
+        void publish() noexcept {
+            auto ring = static_cast<io_uring_buf_ring *>(m_entries.data());
+            std::atomic_ref(ring->tail).store(m_tail, std::memory_order_release);
+        }
+    private:
+        MemoryMap m_entries;
+        MemoryMap m_buffers;
+        int m_ringFd = -1;
+        uint16_t m_groupId = 0;
+        uint16_t m_mask = 0;
+        uint16_t m_tail = 0;
+        size_t m_bufferSize = 0;
+    };
+
+    //Data received into a provided buffer. The buffer is recycled when this object is destroyed.
+    class ProvidedBuffer {
+    public:
+        ProvidedBuffer() noexcept = default;
+        ProvidedBuffer(ProvidedBufferRing & ring, uint16_t id, size_t size) noexcept :
+            m_ring(&ring), m_id(id), m_size(size)
+        {}
+        ~ProvidedBuffer() noexcept
+            { reset(); }
+        ProvidedBuffer(ProvidedBuffer && src) noexcept :
+            m_ring(std::exchange(src.m_ring, nullptr)), m_id(src.m_id), m_size(src.m_size)
+        {}
+        ProvidedBuffer & operator=(ProvidedBuffer src) noexcept {
+            std::swap(m_ring, src.m_ring);
+            std::swap(m_id, src.m_id);
+            std::swap(m_size, src.m_size);
+            return *this;
+        }
+
+        //recycles the buffer early
+        void reset() noexcept {
+            if (m_ring)
+                std::exchange(m_ring, nullptr)->recycle(m_id);
+        }
+
+        auto id() const noexcept -> uint16_t
+            { return m_id; }
+        auto data() const noexcept -> std::span<const std::byte>
+            { return m_ring ? m_ring->buffer(m_id).first(m_size) : std::span<const std::byte>(); }
+
+        explicit operator bool() const noexcept
+            { return m_ring != nullptr; }
+    private:
+        ProvidedBufferRing * m_ring = nullptr;
+        uint16_t m_id = 0;
+        size_t m_size = 0;
+    };
+
+    namespace impl {
+        template<class... Err>
+        inline auto getSubmission(IoUring & ring, Err & ...err) -> io_uring_sqe * {
+            auto sqe = ring.getSubmission();
+            if (!sqe) {
+                //make room by handing the queued entries to the kernel
+                ring.submit(0, err...);
+                if (failed(err...))
+                    return nullptr;
+                sqe = ring.getSubmission();
+                if (!sqe)
+                    handleError(err..., EBUSY, "io_uring submission queue is full");
+            }
+            return sqe;
+        }
+    }
+
+    //Queues an accept that keeps producing a completion per incoming connection until it fails or is cancelled.
+    //flags are accept4() flags
+    inline void queueMultishotAccept(IoUring & ring, SocketLike auto && listener, int flags, uint64_t userData,
+                                     PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto sqe = impl::getSubmission(ring, PTL_ERROR_REF(err));
+        if (!sqe)
+            return;
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = c_socket(std::forward<decltype(listener)>(listener));
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = uint32_t(flags);
+        sqe->user_data = userData;
+        clearError(PTL_ERROR_REF(err));
+    }
+
+    //Queues a receive that keeps producing completions with data in buffers from the ring until it fails,
+    //reaches end of stream or is cancelled. No buffer is held while the connection is idle.
+    inline void queueMultishotReceive(IoUring & ring, SocketLike auto && socket, const ProvidedBufferRing & buffers,
+                                      int flags, uint64_t userData,
+                                      PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto sqe = impl::getSubmission(ring, PTL_ERROR_REF(err));
+        if (!sqe)
+            return;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = c_socket(std::forward<decltype(socket)>(socket));
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->msg_flags = uint32_t(flags);
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffers.groupId();
+        sqe->user_data = userData;
+        clearError(PTL_ERROR_REF(err));
+    }
+
+    //Queues cancellation of the request(s) queued with the given userData
+    inline void queueCancel(IoUring & ring, uint64_t userData, uint64_t cancelUserData,
+                            PTL_ERROR_REF_ARG(err))
+    requires(PTL_ERROR_REQ(err)) {
+        auto sqe = impl::getSubmission(ring, PTL_ERROR_REF(err));
+        if (!sqe)
+            return;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = userData;
+        sqe->user_data = cancelUserData;
+        clearError(PTL_ERROR_REF(err));
+    }
+
+    //socket produced by a multishot accept completion
+    inline auto acceptedSocket(const UringCompletion & completion,
+                               PTL_ERROR_REF_ARG(err)) -> Socket
+    requires(PTL_ERROR_REQ(err)) {
+        if (completion.result < 0) {
+            handleError(PTL_ERROR_REF(err), completion.error(), "io_uring accept failed");
+            return Socket();
+        }
+        clearError(PTL_ERROR_REF(err));
+        return Socket(completion.result);
+    }
+
+    //data produced by a multishot receive completion. An empty result with no error means end of stream.
+    //ENOBUFS means the ring ran out of buffers and the receive has to be queued again after recycling some.
+    inline auto receivedBuffer(const UringCompletion & completion, ProvidedBufferRing & buffers,
+                               PTL_ERROR_REF_ARG(err)) -> ProvidedBuffer
+    requires(PTL_ERROR_REQ(err)) {
+        auto id = completion.bufferId();
+        if (completion.result < 0) {
+            if (id)
+                buffers.recycle(*id);
+            handleError(PTL_ERROR_REF(err), completion.error(), "io_uring recv failed");
+            return {};
+        }
+        clearError(PTL_ERROR_REF(err));
+        if (!id)
+            return {};
+        return ProvidedBuffer(buffers, *id, size_t(completion.result));
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <ptl/async.h>
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <string.h>
+
+using namespace ptl;
+
+#if defined(EPOLLIN) && defined(MSG_DONTWAIT)
+
+namespace {
+
+    //minimal coroutine type: runs eagerly and keeps its frame until destroyed.
+    //Lambdas producing it must outlive the task since the frame refers to their captures.
+    struct Task {
+        struct promise_type {
+            auto get_return_object() noexcept -> Task
+                { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            auto initial_suspend() noexcept -> std::suspend_never
+                { return {}; }
+            auto final_suspend() noexcept -> std::suspend_always
+                { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept
+                { std::terminate(); }
+        };
+
+        explicit Task(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+        Task(Task && src) noexcept : handle(std::exchange(src.handle, nullptr)) {}
+        ~Task() noexcept {
+            if (handle)
+                handle.destroy();
+        }
+
+        auto done() const noexcept -> bool
+            { return handle.done(); }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    void makeNonBlocking(int fd) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+}
+
+TEST_SUITE("async") {
+
+TEST_CASE("async receive and send") {
+    auto loop = EventLoop::create();
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+
+    char buf[16] = {};
+    io_ssize_t received = -2;
+    auto readerBody = [&]() -> Task {
+        received = co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0);
+    };
+    auto reader = readerBody();
+    CHECK(!reader.done());
+    CHECK(loop.pending() == 1);
+    CHECK(loop.runOnce(std::chrono::milliseconds(0)) == 0);
+
+    io_ssize_t sent = -2;
+    auto writerBody = [&]() -> Task {
+        sent = co_await asyncSendSocket(loop, a, "hello", 5, 0);
+    };
+    auto writer = writerBody();
+    //socket is writable so the send completes without suspending
+    CHECK(writer.done());
+    CHECK(sent == 5);
+
+    CHECK(loop.runOnce(std::chrono::milliseconds(1000)) == 1);
+    CHECK(reader.done());
+    CHECK(received == 5);
+    CHECK(memcmp(buf, "hello", 5) == 0);
+    CHECK(loop.pending() == 0);
+}
+
+TEST_CASE("async read and write") {
+    auto loop = EventLoop::create();
+    auto pipe = Pipe::create();
+    makeNonBlocking(pipe.readEnd.get());
+    makeNonBlocking(pipe.writeEnd.get());
+
+    //fill the pipe so that the writer has to wait
+    std::vector<char> chunk(65536, 'x');
+    size_t filled = 0;
+    for (std::error_code ec; ; ) {
+        auto res = writeFile(pipe.writeEnd, chunk.data(), chunk.size(), ec);
+        if (ec)
+            break;
+        filled += size_t(res);
+    }
+    REQUIRE(filled > 0);
+
+    io_ssize_t written = -2;
+    auto writerBody = [&]() -> Task {
+        written = co_await asyncWriteFile(loop, pipe.writeEnd, "end", 3);
+    };
+    auto writer = writerBody();
+    CHECK(!writer.done());
+
+    size_t drained = 0;
+    auto readerBody = [&]() -> Task {
+        while (drained < filled + 3) {
+            auto res = co_await asyncReadFile(loop, pipe.readEnd, chunk.data(), chunk.size());
+            drained += size_t(res);
+        }
+    };
+    auto reader = readerBody();
+    loop.run();
+    CHECK(writer.done());
+    CHECK(reader.done());
+    CHECK(written == 3);
+    CHECK(drained == filled + 3);
+}
+
+TEST_CASE("async deadlines") {
+    auto loop = EventLoop::create();
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+
+    char buf[4];
+    std::error_code ec;
+    io_ssize_t res = -2;
+    auto start = std::chrono::steady_clock::now();
+    auto taskBody = [&]() -> Task {
+        res = co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, AwaitOptions::timeout(std::chrono::milliseconds(20)), ec);
+    };
+    auto task = taskBody();
+    loop.run();
+    CHECK(task.done());
+    CHECK(res == -1);
+    CHECK(errorEquals(ec, std::errc::timed_out));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+    //an expired deadline does not prevent an operation that can complete immediately
+    sendSocket(a, "x", 1, 0);
+    Error err;
+    auto immediateBody = [&]() -> Task {
+        res = co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, AwaitOptions{std::chrono::steady_clock::now()}, err);
+    };
+    auto immediate = immediateBody();
+    CHECK(immediate.done());
+    CHECK(res == 1);
+    CHECK(!err);
+}
+
+TEST_CASE("async cancellation") {
+    auto loop = EventLoop::create();
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+    auto pipe = Pipe::create();
+    makeNonBlocking(pipe.readEnd.get());
+
+    Cancellation cancellation;
+    char buf[4];
+    std::error_code ec;
+    std::error_code thrown;
+    auto firstBody = [&]() -> Task {
+        co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, AwaitOptions{.cancellation = &cancellation}, ec);
+    };
+    auto first = firstBody();
+    auto secondBody = [&]() -> Task {
+        try {
+            co_await asyncReadFile(loop, pipe.readEnd, buf, sizeof(buf), AwaitOptions{.cancellation = &cancellation});
+        } catch (std::system_error & ex) {
+            thrown = ex.code();
+        }
+    };
+    auto second = secondBody();
+    CHECK(loop.pending() == 2);
+    cancellation.cancel();
+    CHECK(loop.runOnce(std::chrono::milliseconds(1000)) == 2);
+    CHECK(first.done());
+    CHECK(second.done());
+    CHECK(errorEquals(ec, std::errc::operation_canceled));
+    CHECK(errorEquals(thrown, std::errc::operation_canceled));
+
+    //already cancelled: fails without trying
+    sendSocket(a, "x", 1, 0);
+    io_ssize_t res = -2;
+    auto thirdBody = [&]() -> Task {
+        res = co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, AwaitOptions{.cancellation = &cancellation}, ec);
+    };
+    auto third = thirdBody();
+    CHECK(third.done());
+    CHECK(res == -1);
+    CHECK(errorEquals(ec, std::errc::operation_canceled));
+    CHECK(receiveSocket(b, buf, sizeof(buf), 0) == 1);
+}
+
+TEST_CASE("async errors") {
+    auto loop = EventLoop::create();
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+
+    char buf[4];
+    std::error_code ec;
+    auto readerBody = [&]() -> Task {
+        co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, ec);
+    };
+    auto reader = readerBody();
+
+    //only one reader per descriptor at a time
+    std::error_code busy;
+    auto anotherBody = [&]() -> Task {
+        co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, busy);
+    };
+    auto another = anotherBody();
+    CHECK(another.done());
+    CHECK(errorEquals(busy, std::errc::device_or_resource_busy));
+
+    a.close();
+    loop.run();
+    CHECK(reader.done());
+    CHECK(!ec);
+
+    io_ssize_t res = -2;
+    Error err;
+    auto writerBody = [&]() -> Task {
+        res = co_await asyncSendSocket(loop, b, "x", 1, MSG_NOSIGNAL, err);
+    };
+    auto writer = writerBody();
+    CHECK(writer.done());
+    CHECK(res == -1);
+    CHECK(err == EPIPE);
+}
+
+TEST_CASE("async abandon") {
+    auto loop = EventLoop::create();
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+
+    char buf[4];
+    Cancellation cancellation;
+    {
+        auto taskBody = [&]() -> Task {
+            co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0, AwaitOptions::timeout(std::chrono::seconds(10), &cancellation));
+        };
+        auto task = taskBody();
+        CHECK(loop.pending() == 1);
+    }
+    CHECK(loop.pending() == 0);
+    CHECK(loop.runOnce(std::chrono::milliseconds(0)) == 0);
+
+    //the descriptor is free to be awaited again
+    sendSocket(a, "x", 1, 0);
+    io_ssize_t res = -2;
+    auto taskBody = [&]() -> Task {
+        res = co_await asyncReceiveSocket(loop, b, buf, sizeof(buf), 0);
+    };
+    auto task = taskBody();
+    CHECK(res == 1);
+}
+
+}
+
+#endif
@@ -7,6 +7,9 @@
 #include "common.h"
 
 #include <cstring>
+#include <signal.h>
+#include <thread>
+#include <vector>
 
 using namespace ptl;
 
@@ -88,6 +91,56 @@ TEST_CASE("openTemp") {
 }
 #endif
 
+#if defined(O_TMPFILE) && defined(AT_EMPTY_PATH)
+TEST_CASE("openAnonymousTemp") {
+    std::error_code ec;
+    auto fd = FileDescriptor::openAnonymousTemp(".", O_RDWR, ec);
+    if (ec) {
+        //not all filesystems support O_TMPFILE
+        CHECK(errorEquals(ec, std::errc::operation_not_supported));
+        return;
+    }
+    REQUIRE(fd);
+    CHECK(writeFile(fd, "hello", 5) == 5);
+
+    std::filesystem::remove("ptl_published");
+    publishFile(fd, "ptl_published");
+    CHECK(std::filesystem::file_size("ptl_published") == 5);
+
+    publishFile(fd, "ptl_published", ec);
+    CHECK(errorEquals(ec, std::errc::file_exists));
+
+    std::filesystem::remove("ptl_published");
+}
+#endif
+
+#if (defined(O_TMPFILE) && defined(AT_EMPTY_PATH)) || PTL_HAVE_MKOSTEMPS
+TEST_CASE("PendingFile") {
+    std::filesystem::remove_all("ptl_pending_dir");
+    std::filesystem::create_directory("ptl_pending_dir");
+
+    {
+        auto file = PendingFile::create("ptl_pending_dir", O_RDWR | O_CLOEXEC, 0644);
+        REQUIRE(file);
+        CHECK(writeFile(file, "hello", 5) == 5);
+        file.publish("ptl_pending_dir/result");
+        CHECK(std::filesystem::file_size("ptl_pending_dir/result") == 5);
+
+        std::error_code ec;
+        file.publish("ptl_pending_dir/result", ec);
+        CHECK(errorEquals(ec, std::errc::file_exists));
+    }
+    {
+        //abandoned files leave nothing behind
+        auto file = PendingFile::create("ptl_pending_dir", O_RDWR);
+        writeFile(file, "bye", 3);
+    }
+    CHECK(std::distance(std::filesystem::directory_iterator("ptl_pending_dir"), std::filesystem::directory_iterator()) == 1);
+
+    std::filesystem::remove_all("ptl_pending_dir");
+}
+#endif
+
 #ifndef _WIN32
 
 TEST_CASE("chmod") {
@@ -248,6 +301,74 @@ TEST_CASE("flock") {
 }
 #endif
 
+TEST_CASE("writeAll and readExact") {
+    auto pipe = Pipe::create();
+    ::fcntl(pipe.writeEnd.get(), F_SETFL, ::fcntl(pipe.writeEnd.get(), F_GETFL) | O_NONBLOCK);
+    ::fcntl(pipe.readEnd.get(), F_SETFL, ::fcntl(pipe.readEnd.get(), F_GETFL) | O_NONBLOCK);
+
+    //non-blocking writer waits for the reader to drain the pipe
+    std::vector<char> out(1024 * 1024);
+    for (size_t i = 0; i < out.size(); ++i)
+        out[i] = char(i % 251);
+    std::vector<char> in(out.size());
+    size_t read = 0;
+    std::thread reader([&]() {
+        read = readExact(pipe.readEnd, in.data(), in.size());
+    });
+    CHECK(writeAll(pipe.writeEnd, out.data(), out.size()) == out.size());
+    reader.join();
+    CHECK(read == in.size());
+    CHECK(in == out);
+
+    //deadline with nobody reading
+    std::error_code ec;
+    auto written = writeAll(pipe.writeEnd, out.data(), out.size(), std::chrono::steady_clock::now() + std::chrono::milliseconds(20), ec);
+    CHECK(errorEquals(ec, std::errc::timed_out));
+    CHECK(written > 0);
+    CHECK(written < out.size());
+    CHECK(readExact(pipe.readEnd, in.data(), written, ec) == written);
+    CHECK(!ec);
+    CHECK(memcmp(in.data(), out.data(), written) == 0);
+
+    CHECK(readExact(pipe.readEnd, in.data(), 1, std::chrono::steady_clock::now() + std::chrono::milliseconds(10), ec) == 0);
+    CHECK(errorEquals(ec, std::errc::timed_out));
+
+    //end of file is reported via the count
+    writeAll(pipe.writeEnd, "abc", 3);
+    pipe.writeEnd.close();
+    char buf[8];
+    CHECK(readExact(pipe.readEnd, buf, sizeof(buf), ec) == 3);
+    CHECK(!ec);
+}
+
+TEST_CASE("vectored writeAll and readExact") {
+    auto pipe = Pipe::create();
+    ::fcntl(pipe.writeEnd.get(), F_SETFL, ::fcntl(pipe.writeEnd.get(), F_GETFL) | O_NONBLOCK);
+
+    std::vector<char> first(200000, 'a'), second(100000, 'b');
+    const ::iovec out[] = {{first.data(), first.size()}, {nullptr, 0}, {second.data(), second.size()}};
+    std::vector<char> in1(150001), in2(149999);
+    const ::iovec in[] = {{in1.data(), in1.size()}, {in2.data(), in2.size()}};
+
+    size_t read = 0;
+    std::thread reader([&]() {
+        read = readExact(pipe.readEnd, in);
+    });
+    CHECK(writeAll(pipe.writeEnd, out) == first.size() + second.size());
+    reader.join();
+    CHECK(read == in1.size() + in2.size());
+    CHECK(std::count(in1.begin(), in1.end(), 'a') == ptrdiff_t(in1.size()));
+    CHECK(std::count(in2.begin(), in2.end(), 'a') == ptrdiff_t(first.size() - in1.size()));
+    CHECK(in2.back() == 'b');
+
+    Error err;
+    pipe.readEnd.close();
+    ::signal(SIGPIPE, SIG_IGN);
+    CHECK(writeAll(pipe.writeEnd, out, err) == 0);
+    CHECK(err == EPIPE);
+    ::signal(SIGPIPE, SIG_DFL);
+}
+
 #endif
 
 }
@@ -0,0 +1,146 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <ptl/packet.h>
+#include <ptl/spawn.h>
+
+#include "common.h"
+
+#include <net/if.h>
+#include <sched.h>
+#include <string.h>
+
+using namespace ptl;
+
+#if defined(PACKET_RX_RING) && defined(TPACKET3_HDRLEN)
+
+namespace {
+
+    auto loopbackSettings() -> PacketCaptureSettings {
+        PacketCaptureSettings settings;
+        settings.interfaceIndex = int(if_nametoindex("lo"));
+        settings.blockSize = 1u << 16;
+        settings.blockCount = 4;
+        settings.blockTimeout = std::chrono::milliseconds(10);
+        return settings;
+    }
+}
+
+TEST_SUITE("packet") {
+
+TEST_CASE("packet capture") {
+    std::error_code ec;
+    auto capture = PacketCapture::create(loopbackSettings(), ec);
+    if (errorEquals(ec, std::errc::operation_not_permitted))
+        return; //needs CAP_NET_RAW
+    REQUIRE(!ec);
+    REQUIRE(capture);
+    CHECK(capture.blockCount() == 4);
+    CHECK(capture.blockSize() == 1u << 16);
+
+    auto receiver = createSocket(AF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto sender = createSocket(AF_INET, SOCK_DGRAM, 0);
+    const char payload[] = "ptl packet capture test";
+    sendSocket(sender, payload, sizeof(payload), 0, getSocketName(receiver));
+
+    bool found = false;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!found && std::chrono::steady_clock::now() < deadline) {
+        auto block = capture.nextBlock(std::chrono::milliseconds(1000));
+        for (auto packet: block) {
+            CHECK(packet.interfaceIndex() == loopbackSettings().interfaceIndex);
+            CHECK(packet.length() >= packet.data().size());
+            CHECK(packet.networkOffset() <= packet.data().size());
+            auto data = packet.data();
+            auto it = std::search(data.begin(), data.end(),
+                                  reinterpret_cast<const std::byte *>(payload), reinterpret_cast<const std::byte *>(payload) + sizeof(payload));
+            if (it != data.end()) {
+                found = true;
+                CHECK(!packet.truncated());
+                CHECK(packet.timestamp().time_since_epoch().count() != 0);
+            }
+        }
+    }
+    CHECK(found);
+
+    auto stats = capture.statistics();
+    CHECK(stats.packets >= 1);
+
+    CHECK_THROWS_MATCHES(PacketCapture::create(PacketCaptureSettings{.blockSize = 4096, .frameSize = 1000}), std::errc::invalid_argument);
+}
+
+TEST_CASE("packet capture not open") {
+    PacketCapture capture;
+    CHECK(!capture);
+    CHECK(capture.tryNextBlock().empty());
+    CHECK_THROWS_MATCHES(capture.nextBlock(std::chrono::milliseconds(0)), std::errc::bad_file_descriptor);
+}
+
+TEST_CASE("packet capture interface down") {
+    //loopback starts down in a fresh network namespace and binding to a down interface leaves ENETDOWN pending
+    auto pipe = Pipe::create();
+    auto child = forkProcess();
+    if (!child) {
+        pipe.readEnd.close();
+        int result = -1;
+        if (::unshare(CLONE_NEWNET) == 0) {
+            std::error_code ec;
+            auto capture = PacketCapture::create(loopbackSettings(), ec);
+            if (!ec) {
+                const auto start = std::chrono::steady_clock::now();
+                capture.nextBlock(std::chrono::milliseconds(2000), ec);
+                //must not spin until the timeout
+                result = std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000) ? ec.value() : 0;
+            }
+        }
+        writeFile(pipe.writeEnd, &result, sizeof(result));
+        ::_exit(0);
+    }
+    pipe.writeEnd.close();
+    int result = 0;
+    readFile(pipe.readEnd, &result, sizeof(result));
+    child.wait();
+    if (result == -1) {
+        MESSAGE("skipped: needs CAP_SYS_ADMIN and CAP_NET_RAW");
+        return;
+    }
+    CHECK(result == ENETDOWN);
+}
+
+TEST_CASE("packet capture timeout") {
+    auto settings = loopbackSettings();
+    settings.protocol = 0x88b5;     //local experimental ethertype nobody sends
+    std::error_code ec;
+    auto capture = PacketCapture::create(settings, ec);
+    if (errorEquals(ec, std::errc::operation_not_permitted))
+        return;
+    REQUIRE(!ec);
+
+    auto block = capture.nextBlock(std::chrono::milliseconds(30), ec);
+    CHECK(!ec);
+    //either nothing or an empty block retired by the timer
+    CHECK(block.empty());
+    CHECK(!capture.tryNextBlock());
+}
+
+TEST_CASE("packet fanout") {
+    std::error_code ec;
+    auto first = PacketCapture::create(loopbackSettings(), ec);
+    if (errorEquals(ec, std::errc::operation_not_permitted))
+        return;
+    auto second = PacketCapture::create(loopbackSettings());
+    auto other = PacketCapture::create(loopbackSettings());
+
+    const uint16_t groupId = uint16_t(getpid());
+    first.joinFanout(groupId, PACKET_FANOUT_HASH);
+    second.joinFanout(groupId, PACKET_FANOUT_HASH);
+
+    //a group cannot be joined with a different mode
+    other.joinFanout(groupId, PACKET_FANOUT_LB, ec);
+    CHECK(errorEquals(ec, std::errc::invalid_argument));
+}
+
+}
+
+#endif
@@ -0,0 +1,161 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <ptl/pool.h>
+#include <ptl/socket.h>
+
+#include "common.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace ptl;
+
+#if !defined(_WIN32)
+
+TEST_SUITE("pool") {
+
+TEST_CASE("buffer pool") {
+    auto pool = BufferPool::create({.bufferSize = 100, .count = 8, .cacheSize = 4});
+    REQUIRE(pool);
+    CHECK(pool.bufferSize() == 100);
+    CHECK(pool.count() == 8);
+    //too small to cache anything
+    CHECK(pool.cacheSize() == 0);
+
+    std::vector<PooledBuffer> held;
+    std::set<std::byte *> addresses;
+    for (int i = 0; i < 8; ++i) {
+        auto buf = pool.acquire();
+        REQUIRE(buf);
+        CHECK(buf.size() == 100);
+        memset(buf.data(), i, buf.size());
+        addresses.insert(buf.data());
+        held.push_back(std::move(buf));
+    }
+    CHECK(addresses.size() == 8);
+    CHECK(!pool.tryAcquire());
+    std::error_code ec;
+    CHECK(!pool.acquire(ec));
+    CHECK(errorEquals(ec, std::errc::no_buffer_space));
+    CHECK(pool.statistics().exhaustions == 2);
+
+    //buffers do not overlap
+    for (size_t i = 0; i < held.size(); ++i)
+        CHECK(std::all_of(held[i].data(), held[i].data() + held[i].size(), [&](std::byte b) { return b == std::byte(i); }));
+
+    held.pop_back();
+    auto again = pool.acquire();
+    CHECK(addresses.contains(again.data()));
+    again.reset();
+    CHECK(!again);
+    held.clear();
+
+    //everything is back, including what the thread cache spilled
+    for (int i = 0; i < 8; ++i)
+        held.push_back(pool.acquire());
+    CHECK(pool.statistics().crossThreadReturns == 0);
+
+    CHECK_THROWS_MATCHES(BufferPool::create({.bufferSize = 0, .count = 8}), std::errc::invalid_argument);
+    CHECK_THROWS_MATCHES(BufferPool::create({.bufferSize = 8, .count = 0}), std::errc::invalid_argument);
+}
+
+TEST_CASE("buffer pool threads") {
+    auto pool = BufferPool::create({.bufferSize = 64, .count = 64, .cacheSize = 8, .hugePages = true});
+
+    std::vector<PooledBuffer> handedOver;
+    for (int i = 0; i < 10; ++i)
+        handedOver.push_back(pool.acquire());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, t, moved = t == 0 ? std::move(handedOver) : std::vector<PooledBuffer>()]() mutable {
+            moved.clear();
+            for (int i = 0; i < 10000; ++i) {
+                PooledBuffer bufs[3];
+                for (auto & buf: bufs) {
+                    buf = pool.acquire();
+                    buf.data()[0] = std::byte(t);
+                }
+                for (auto & buf: bufs)
+                    CHECK(buf.data()[0] == std::byte(t));
+            }
+        });
+    }
+    for (auto & thread: threads)
+        thread.join();
+    CHECK(pool.statistics().crossThreadReturns == 10);
+    CHECK(pool.statistics().exhaustions == 0);
+
+    //exited threads gave their caches back
+    std::vector<PooledBuffer> all;
+    for (int i = 0; i < 64; ++i)
+        all.push_back(pool.acquire());
+}
+
+TEST_CASE("buffer pool thread caches") {
+    auto pool = BufferPool::create({.bufferSize = 64, .count = 64});
+    CHECK(pool.cacheSize() == 8);
+
+    //leaves free buffers in the cache of a thread that is still alive but idle
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool cached = false, done = false;
+    std::thread idle([&]() {
+        pool.acquire().reset();
+        std::unique_lock lock(mutex);
+        cached = true;
+        cv.notify_one();
+        cv.wait(lock, [&] { return done; });
+    });
+    {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [&] { return cached; });
+    }
+
+    std::vector<PooledBuffer> all;
+    for (int i = 0; i < 64; ++i)
+        all.push_back(pool.acquire());
+    CHECK(pool.statistics().exhaustions == 0);
+    CHECK(!pool.tryAcquire());
+    CHECK(pool.statistics().exhaustions == 1);
+
+    {
+        std::lock_guard lock(mutex);
+        done = true;
+    }
+    cv.notify_one();
+    idle.join();
+}
+
+TEST_CASE("buffer pool receive") {
+    auto pool = BufferPool::create({.bufferSize = 2048, .count = 16});
+
+    auto receiver = createSocket(AF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto sender = createSocket(AF_INET, SOCK_DGRAM, 0);
+    auto dest = getSocketName(receiver);
+    for (int i = 0; i < 4; ++i)
+        sendSocket(sender, "abcd", size_t(i + 1), 0, dest);
+
+    auto first = pool.acquire();
+    CHECK(receiveSocket(receiver, first.data(), first.size(), 0) == 1);
+
+    SocketBatch batch(4, 0);
+    PooledBuffer bufs[4];
+    for (size_t i = 0; i < 4; ++i) {
+        bufs[i] = pool.acquire();
+        batch.setBuffer(i, bufs[i].buffer());
+    }
+    CHECK(receiveSocketBatch(receiver, batch, 3, MSG_DONTWAIT) == 3);
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(batch.data(i).size() == i + 2);
+        CHECK(batch.data(i).data() == bufs[i].data());
+    }
+}
+
+}
+
+#endif
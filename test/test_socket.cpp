@@ -7,6 +7,20 @@
 #include <string.h>
 
 #include <thread>
+#include <unordered_set>
+#include <random>
+
+#if __has_include(<arpa/inet.h>)
+    #include <arpa/inet.h>
+#endif
+
+#if __has_include(<poll.h>)
+    #include <poll.h>
+#endif
+
+#if __has_include(<sched.h>)
+    #include <sched.h>
+#endif
 
 using namespace ptl;
 
@@ -102,6 +116,50 @@ TEST_CASE( "byte sized socket options" ) {
     }
 }
 
+TEST_CASE( "TCP options" ) {
+    auto sock = createSocket(PF_INET, SOCK_STREAM, 0);
+    REQUIRE(sock);
+
+    #ifdef TCP_NODELAY
+    {
+        INFO("SockOptTCPNoDelay");
+        setSocketOption(sock, SockOptTCPNoDelay, true);
+        CHECK(getSocketOption(sock, SockOptTCPNoDelay));
+    }
+    #endif
+    #ifdef TCP_KEEPINTVL
+    {
+        INFO("SockOptTCPKeepInterval");
+        setSocketOption(sock, SockOptTCPKeepInterval, 17);
+        CHECK(getSocketOption(sock, SockOptTCPKeepInterval) == 17);
+    }
+    #endif
+    #ifdef TCP_KEEPCNT
+    {
+        INFO("SockOptTCPKeepCount");
+        setSocketOption(sock, SockOptTCPKeepCount, 4);
+        CHECK(getSocketOption(sock, SockOptTCPKeepCount) == 4);
+    }
+    #endif
+    #ifdef TCP_USER_TIMEOUT
+    {
+        INFO("SockOptTCPUserTimeout");
+        setSocketOption(sock, SockOptTCPUserTimeout, 5000u);
+        CHECK(getSocketOption(sock, SockOptTCPUserTimeout) == 5000u);
+    }
+    #endif
+    #ifdef TCP_CONGESTION
+    {
+        INFO("SockOptTCPCongestion");
+        CHECK(!getSocketOption(sock, SockOptTCPCongestion).empty());
+        //reno is always built into Linux
+        setSocketOption(sock, SockOptTCPCongestion, "reno");
+        CHECK(getSocketOption(sock, SockOptTCPCongestion) == "reno");
+        CHECK_THROWS_MATCHES(setSocketOption(sock, SockOptTCPCongestion, std::string(64, 'x')), std::errc::invalid_argument);
+    }
+    #endif
+}
+
 TEST_CASE( "read-write" ) {
 
     auto recvSock = createSocket(PF_INET, SOCK_DGRAM, 0);
@@ -143,8 +201,148 @@ TEST_CASE("low-level socket options") {
     CHECK(len == sizeof(out));
 }
 
+TEST_CASE("socket address") {
+    constexpr auto loopback = SocketAddress::ipv4({127, 0, 0, 1}, 8080);
+    static_assert(loopback.length() == sizeof(sockaddr_in));
+    constexpr auto v6 = SocketAddress::ipv6({0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,1}, 8080, 3);
+    static_assert(v6.length() == sizeof(sockaddr_in6));
+
+    CHECK(SocketAddress().family() == AF_UNSPEC);
+    CHECK(!SocketAddress());
+    CHECK(loopback.family() == AF_INET);
+    CHECK(loopback.port() == 8080);
+    REQUIRE(loopback.asIPv4());
+    CHECK(loopback.asIPv4()->sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+    CHECK(!loopback.asIPv6());
+    CHECK(v6.family() == AF_INET6);
+    CHECK(v6.port() == 8080);
+    CHECK(v6.scopeId() == 3);
+    CHECK(memcmp(&v6.asIPv6()->sin6_addr, &in6addr_loopback, sizeof(in6_addr)) == 0);
+
+    CHECK(loopback == SocketAddress::ipv4(INADDR_LOOPBACK, 8080));
+    CHECK(loopback != SocketAddress::ipv4(INADDR_LOOPBACK, 8081));
+    CHECK(v6 != SocketAddress::ipv6({0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,1}, 8080));
+    CHECK(loopback.hash() == SocketAddress::ipv4(INADDR_LOOPBACK, 8080).hash());
+
+    std::unordered_set<SocketAddress> table{loopback, v6};
+    CHECK(table.contains(SocketAddress(loopback.data(), loopback.length())));
+    CHECK(!table.contains(SocketAddress::ipv4({127, 0, 0, 2}, 8080)));
+
+    auto receiver = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto bound = getSocketName(receiver);
+    CHECK(bound.family() == AF_INET);
+    CHECK(bound.port() != 0);
+
+    auto sender = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(sender, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    CHECK(sendSocket(sender, "hello", 5, 0, bound) == 5);
+    char buf[8];
+    SocketAddress from;
+    CHECK(receiveSocket(receiver, buf, sizeof(buf), 0, from) == 5);
+    CHECK(from == getSocketName(sender));
+}
+
+TEST_CASE("address text") {
+    constexpr auto literal = SocketAddress::parse("127.0.0.1:80");
+    static_assert(literal && literal->length() == sizeof(sockaddr_in));
+    CHECK(*literal == SocketAddress::ipv4({127, 0, 0, 1}, 80));
+    
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<uint32_t> dist;
+    char buf[SocketAddress::maxTextLength];
+    char expected[INET6_ADDRSTRLEN];
+    for (int i = 0; i < 1000; ++i) {
+        in_addr addr;
+        addr.s_addr = dist(gen);
+        auto end = formatIPv4Address(addr, buf);
+        REQUIRE(inet_ntop(AF_INET, &addr, expected, sizeof(expected)));
+        CHECK(std::string_view(buf, end) == expected);
+        in_addr parsed{};
+        CHECK(parseIPv4Address(std::string_view(buf, end), parsed));
+        CHECK(parsed.s_addr == addr.s_addr);
+
+        in6_addr addr6;
+        for (auto & byte: addr6.s6_addr)
+            byte = uint8_t(dist(gen));
+        //exercise zero compression
+        addr6.s6_addr[0] |= 1;
+        for (size_t j = 2 * (dist(gen) % 8), len = 2 * (dist(gen) % 4); j < 16 && len; ++j, --len)
+            addr6.s6_addr[j] = 0;
+        end = formatIPv6Address(addr6, buf);
+        REQUIRE(inet_ntop(AF_INET6, &addr6, expected, sizeof(expected)));
+        CHECK(std::string_view(buf, end) == expected);
+        in6_addr parsed6{};
+        CHECK(parseIPv6Address(std::string_view(buf, end), parsed6));
+        CHECK(memcmp(&parsed6, &addr6, sizeof(addr6)) == 0);
+    }
+
+    for (const char * text: {"::", "::1", "1::", "1:2:3:4:5:6:7:8", "1::8", "fe80::1:2", "::ffff:1.2.3.4", "2001:db8::1:0:0:1", 
+                             "ABCD::EF", "1:2:3:4:5:6:1.2.3.4"}) {
+        INFO(text);
+        in6_addr expectedAddr{}, addr{};
+        REQUIRE(inet_pton(AF_INET6, text, &expectedAddr) == 1);
+        CHECK(parseIPv6Address(text, addr));
+        CHECK(memcmp(&expectedAddr, &addr, sizeof(addr)) == 0);
+    }
+    for (const char * text: {"", ":", ":::", "1:", ":1", "1:::2", "1::2::3", "12345::", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7::8", 
+                             "1:2:3:4:5:6:7:1.2.3.4", "::1.2.3", "::01.2.3.4", "g::"}) {
+        INFO(text);
+        in6_addr addr{};
+        CHECK(!parseIPv6Address(text, addr));
+    }
+    for (const char * text: {"", "1", "1.2.3", "1.2.3.4.", "1.2.3.256", "01.2.3.4", "1..2.3", "1.2.3.4 ", "1234.1.1.1"}) {
+        INFO(text);
+        in_addr addr{};
+        CHECK(!parseIPv4Address(text, addr));
+    }
+
+    auto addr = SocketAddress::parse("[fe80::1%3]:8080");
+    REQUIRE(addr);
+    CHECK(addr->port() == 8080);
+    CHECK(addr->scopeId() == 3);
+    CHECK(addr->toString() == "[fe80::1%3]:8080");
+    CHECK(SocketAddress::parse("::1")->toString() == "[::1]:0");
+    CHECK(SocketAddress::parse("10.0.0.1:65535")->toString() == "10.0.0.1:65535");
+    CHECK(!SocketAddress::parse("10.0.0.1:65536"));
+    CHECK(!SocketAddress::parse("10.0.0.1:"));
+    CHECK(!SocketAddress::parse("[::1]80"));
+    CHECK(!SocketAddress::parse("[::1"));
+
+    CHECK(ptl::impl::format("{}", *addr) == "[fe80::1%3]:8080");
+    CHECK(ptl::impl::format("{:>12}", SocketAddress::ipv4({1, 2, 3, 4}, 5)) == "   1.2.3.4:5");
+    #ifdef __linux__
+        CHECK(SocketAddress::unixAbstract("name").toString() == "@name");
+    #endif
+    #ifndef _WIN32
+        CHECK(SocketAddress::unixPath("/tmp/x").toString() == "/tmp/x");
+    #endif
+}
+
 #ifndef _WIN32
 
+TEST_CASE("unix socket address") {
+    auto path = SocketAddress::unixPath("/tmp/sock");
+    CHECK(path.family() == AF_UNIX);
+    CHECK(path.unixPath() == "/tmp/sock");
+    CHECK(!path.isAbstract());
+    CHECK(path == SocketAddress(path.data(), path.length()));
+    CHECK(path != SocketAddress::unixPath("/tmp/sock2"));
+    CHECK_THROWS_MATCHES(SocketAddress::unixPath(std::string(200, 'a')), std::errc::filename_too_long);
+
+    #ifdef __linux__
+        auto abstract = SocketAddress::unixAbstract("ptl-test-" + std::to_string(getpid()));
+        CHECK(abstract.isAbstract());
+        CHECK(abstract != SocketAddress::unixPath(abstract.unixPath()));
+
+        auto sock = createSocket(PF_UNIX, SOCK_DGRAM, 0);
+        bindSocket(sock, abstract);
+        auto bound = getSocketName(sock);
+        CHECK(bound == abstract);
+        CHECK(bound.unixPath() == abstract.unixPath());
+    #endif
+}
+
 TEST_CASE("connected socket send/recv") {
     int rawPair[2];
     REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, rawPair) == 0);
@@ -159,6 +357,939 @@ TEST_CASE("connected socket send/recv") {
     CHECK(memcmp(buf, "hello", 5) == 0);
 }
 
+TEST_CASE("sendAll and receiveExact") {
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+    setSocketOption(a, SockOptSndBuf, 4096u);
+
+    std::vector<char> out(512 * 1024);
+    for (size_t i = 0; i < out.size(); ++i)
+        out[i] = char(i % 253);
+    std::vector<char> in(out.size());
+    size_t received = 0;
+    std::thread receiver([&]() {
+        received = receiveExact(b, in.data(), in.size(), 0);
+    });
+    //MSG_DONTWAIT makes every send non-blocking so the helper has to wait for space
+    CHECK(sendAll(a, out.data(), out.size(), MSG_DONTWAIT) == out.size());
+    receiver.join();
+    CHECK(received == in.size());
+    CHECK(in == out);
+
+    std::error_code ec;
+    char buf[4];
+    CHECK(receiveExact(b, buf, sizeof(buf), MSG_DONTWAIT, std::chrono::steady_clock::now() + std::chrono::milliseconds(10), ec) == 0);
+    CHECK(errorEquals(ec, std::errc::timed_out));
+
+    const char part1[] = "hel", part2[] = "lo";
+    const ::iovec iov[] = {{const_cast<char *>(part1), 3}, {const_cast<char *>(part2), 2}};
+    CHECK(sendAll(a, iov, 0) == 5);
+    char in1[2], in2[8];
+    const ::iovec inIov[] = {{in1, sizeof(in1)}, {in2, sizeof(in2)}};
+    a.close();
+    //peer shutdown ends the transfer early without an error
+    CHECK(receiveExact(b, inIov, 0, ec) == 5);
+    CHECK(!ec);
+    CHECK(memcmp(in1, "he", 2) == 0);
+    CHECK(memcmp(in2, "llo", 3) == 0);
+
+    Error err;
+    CHECK(sendAll(b, "x", 1, MSG_NOSIGNAL, err) == 0);
+    CHECK(err == EPIPE);
+}
+
+#if defined(SO_ATTACH_FILTER) && __has_include(<linux/filter.h>)
+
+TEST_CASE("socket filters") {
+    constexpr auto lengthFilter = bpfLengthRange(BpfUdpPayloadOffset + 2, BpfUdpPayloadOffset + 3);
+    static_assert(lengthFilter.size() == 5 && lengthFilter.valid());
+    static_assert(!BpfProgram<2>().loadLength().jumpIfEqual(1, 0, 1).valid());
+    static_assert(!BpfProgram<1>().loadLength().valid());
+
+    auto receiver = createSocket(AF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto dest = getSocketName(receiver);
+    auto sender1 = createSocket(AF_INET, SOCK_DGRAM, 0);
+    bindSocket(sender1, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto sender2 = createSocket(AF_INET, SOCK_DGRAM, 0);
+
+    //returns the datagrams that made it through
+    auto drain = [&]() {
+        std::string ret;
+        char buf[16];
+        for (std::error_code ec; ; ) {
+            auto res = receiveSocket(receiver, buf, sizeof(buf), MSG_DONTWAIT, ec);
+            if (ec)
+                break;
+            ret.append(buf, size_t(res)).append("|");
+        }
+        return ret;
+    };
+
+    attachSocketFilter(receiver, bpfUdpFirstByte('A'));
+    sendSocket(sender1, "Bxx", 3, 0, dest);
+    sendSocket(sender1, "Axx", 3, 0, dest);
+    CHECK(drain() == "Axx|");
+
+    attachSocketFilter(receiver, lengthFilter);
+    sendSocket(sender1, "a", 1, 0, dest);
+    sendSocket(sender1, "ab", 2, 0, dest);
+    sendSocket(sender1, "abc", 3, 0, dest);
+    sendSocket(sender1, "abcd", 4, 0, dest);
+    CHECK(drain() == "ab|abc|");
+
+    attachSocketFilter(receiver, bpfUdpSourcePort(getSocketName(sender1).port()));
+    sendSocket(sender2, "2", 1, 0, dest);
+    sendSocket(sender1, "1", 1, 0, dest);
+    CHECK(drain() == "1|");
+
+    detachSocketFilter(receiver);
+    sendSocket(sender2, "2", 1, 0, dest);
+    CHECK(drain() == "2|");
+
+    std::error_code ec;
+    detachSocketFilter(receiver, ec);
+    CHECK(errorEquals(ec, std::errc::no_such_file_or_directory));
+
+    CHECK_THROWS_MATCHES(attachSocketFilter(receiver, BpfProgram<1>().loadLength()), std::errc::invalid_argument);
+
+    attachSocketFilter(receiver, BpfProgram<1>().accept());
+    lockSocketFilter(receiver);
+    detachSocketFilter(receiver, ec);
+    CHECK(errorEquals(ec, std::errc::operation_not_permitted));
+}
+
+#endif
+
+#if defined(__linux__) && defined(TCP_ULP) && defined(SOL_TLS) && defined(TLS_SET_RECORD_TYPE) && defined(TLS_CIPHER_CHACHA20_POLY1305)
+
+TEST_CASE("kernel TLS") {
+    const uint8_t key[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    const uint8_t iv[8] = {};
+    const uint8_t salt[4] = {0xa, 0xb, 0xc, 0xd};
+    const uint8_t seq[8] = {};
+    auto info = makeTlsCryptoInfo<::tls12_crypto_info_aes_gcm_128>(TlsVersion12, key, iv, salt, seq);
+    CHECK(info.info.version == TLS_1_2_VERSION);
+    CHECK(info.info.cipher_type == TLS_CIPHER_AES_GCM_128);
+    CHECK(memcmp(info.key, key, sizeof(key)) == 0);
+    CHECK(memcmp(info.salt, salt, sizeof(salt)) == 0);
+
+    const uint8_t chachaKey[32] = {};
+    const uint8_t chachaIv[12] = {};
+    auto chacha = makeTlsCryptoInfo<::tls12_crypto_info_chacha20_poly1305>(TlsVersion13, chachaKey, chachaIv, {}, seq);
+    CHECK(chacha.info.cipher_type == TLS_CIPHER_CHACHA20_POLY1305);
+    CHECK_THROWS_MATCHES(makeTlsCryptoInfo<::tls12_crypto_info_aes_gcm_256>(TlsVersion13, key, iv, salt, seq), std::errc::invalid_argument);
+
+    auto listener = createSocket(AF_INET, SOCK_STREAM, 0);
+    bindSocket(listener, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    listenSocket(listener, 1);
+    auto client = createSocket(AF_INET, SOCK_STREAM, 0);
+    connectSocket(client, getSocketName(listener));
+    auto server = acceptSocket(listener, 0);
+
+    std::error_code ec;
+    //crypto info needs the ULP first
+    setSocketOption(client, SockOptTlsTx, info, ec);
+    CHECK(ec);
+
+    enableKernelTls(client, ec);
+    if (errorEquals(ec, std::errc::no_such_file_or_directory))
+        return; //no kernel TLS support
+    REQUIRE(!ec);
+    CHECK(getSocketOption(client, SockOptTCPUlp) == "tls");
+    enableKernelTls(server);
+    setSocketOption(client, SockOptTlsTx, info);
+    setSocketOption(server, SockOptTlsRx, info);
+
+    CHECK(sendSocket(client, "hello", 5, 0) == 5);
+    char buf[16];
+    auto received = receiveTlsRecord(server, buf, sizeof(buf), 0);
+    CHECK(received.size == 5);
+    CHECK(received.type == TlsRecordType::ApplicationData);
+    CHECK(memcmp(buf, "hello", 5) == 0);
+
+    const uint8_t alert[] = {1, 0};
+    CHECK(sendTlsRecord(client, TlsRecordType::Alert, alert, sizeof(alert), 0) == 2);
+    receiveSocket(server, buf, sizeof(buf), 0, ec);
+    CHECK(errorEquals(ec, std::errc::io_error));
+    received = receiveTlsRecord(server, buf, sizeof(buf), 0);
+    CHECK(received.size == 2);
+    CHECK(received.type == TlsRecordType::Alert);
+}
+
+#endif
+
+TEST_CASE("socket queue sizes") {
+    auto receiver = createSocket(AF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto dest = getSocketName(receiver);
+    auto sender = createSocket(AF_INET, SOCK_DGRAM, 0);
+
+    CHECK(getReceiveQueueSize(receiver) == 0);
+    char big[100] = {};
+    sendSocket(sender, big, sizeof(big), 0, dest);
+    sendSocket(sender, "small", 5, 0, dest);
+
+    #ifdef __linux__
+    CHECK(getReceiveQueueSize(receiver) == sizeof(big));
+    CHECK(getNextDatagramSize(receiver, MSG_DONTWAIT) == io_ssize_t(sizeof(big)));
+    //peeking does not consume
+    CHECK(getNextDatagramSize(receiver, 0) == io_ssize_t(sizeof(big)));
+    #endif
+    char buf[128];
+    CHECK(receiveSocket(receiver, buf, sizeof(buf), 0) == io_ssize_t(sizeof(big)));
+    #ifdef __linux__
+    CHECK(getNextDatagramSize(receiver, MSG_DONTWAIT) == 5);
+    CHECK(receiveSocket(receiver, buf, sizeof(buf), 0) == 5);
+    std::error_code ec;
+    CHECK(getNextDatagramSize(receiver, MSG_DONTWAIT, ec) == -1);
+    CHECK(errorEquals(ec, std::errc::resource_unavailable_try_again));
+    #endif
+
+    auto listener = createSocket(AF_INET, SOCK_STREAM, 0);
+    bindSocket(listener, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    listenSocket(listener, 1);
+    auto client = createSocket(AF_INET, SOCK_STREAM, 0);
+    connectSocket(client, getSocketName(listener));
+    auto server = acceptSocket(listener, 0);
+
+    char data[1000] = {};
+    sendAll(client, data, sizeof(data), 0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (getReceiveQueueSize(server) < sizeof(data) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(getReceiveQueueSize(server) == sizeof(data));
+    #if defined(SIOCOUTQ) || defined(SO_NWRITE)
+    CHECK(getSendQueueSize(client) <= sizeof(data));
+    #endif
+    #ifdef SIOCOUTQNSD
+    CHECK(getUnsentSize(client) <= sizeof(data));
+    #endif
+}
+
+TEST_CASE("message header") {
+    int rawPair[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_DGRAM, 0, rawPair) == 0);
+    FileDescriptor a(rawPair[0]), b(rawPair[1]);
+
+    std::array<int, 2> passed = {rawPair[0], rawPair[1]};
+    MessageHeader<2, ControlMessageSpace<std::array<int, 2>>> out;
+    out.payload("hel", 3).payload(std::span("lo", 2)).control(SOL_SOCKET, SCM_RIGHTS, std::span(passed));
+    CHECK(out.iov().size() == 2);
+    CHECK(sendSocket(a, out, 0) == 5);
+
+    char buf1[2], buf2[8];
+    MessageHeader<2, ControlMessageSpace<std::array<int, 2>>> in;
+    in.payload(buf1, sizeof(buf1)).payload(std::span(buf2));
+    CHECK(receiveSocket(b, in, 0) == 5);
+    CHECK(memcmp(buf1, "he", 2) == 0);
+    CHECK(memcmp(buf2, "llo", 3) == 0);
+    CHECK(!in.controlTruncated());
+
+    auto rights = in.controlMessages().find(SOL_SOCKET, SCM_RIGHTS);
+    REQUIRE(rights);
+    REQUIRE(rights->count<int>() == 2);
+    CHECK(!rights->as<int>(2));
+    for (size_t i = 0; i < 2; ++i) {
+        FileDescriptor received(*rights->as<int>(i));
+        CHECK(received.get() >= 0);
+        CHECK(received.get() != passed[i]);
+    }
+    size_t seen = 0;
+    for (auto message: in.controlMessages()) {
+        CHECK(message.is(SOL_SOCKET, SCM_RIGHTS));
+        ++seen;
+    }
+    CHECK(seen == 1);
+
+    MessageHeader<1> small;
+    small.payload(buf1, 1);
+    CHECK_THROWS_MATCHES(small.payload(buf1, 1), std::errc::invalid_argument);
+    CHECK_THROWS_MATCHES(small.control(SOL_SOCKET, SCM_RIGHTS, 0), std::errc::invalid_argument);
+
+    alignas(cmsghdr) std::byte garbage[ControlMessageSpace<int>] = {};
+    CHECK(ControlMessages(garbage, sizeof(garbage)).empty());
+    CHECK(ControlMessages(garbage, 4).empty());
+    CHECK(ControlMessages().empty());
+}
+
+TEST_CASE("message header addresses") {
+    auto recvSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(recvSock, SocketAddress::ipv4({127, 0, 0, 1}, 0));
+    auto dest = getSocketName(recvSock);
+
+    auto sendSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(sendSock, SocketAddress::ipv4({127, 0, 0, 1}, 0));
+
+    MessageHeader<1> out;
+    out.payload("ping", 4).address(dest);
+    CHECK(sendSocket(sendSock, out, 0) == 4);
+
+    char buf[8];
+    MessageHeader<1, 64> in;
+    in.payload(buf, sizeof(buf));
+    CHECK(receiveSocket(recvSock, in, 0) == 4);
+    CHECK(in.address() == getSocketName(sendSock));
+    CHECK(in.controlMessages().empty());
+
+    in.clear();
+    CHECK(in.iov().empty());
+    CHECK(!in.address());
+}
+
+TEST_CASE("socket pair") {
+    auto pair = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(pair.first);
+    REQUIRE(pair.second);
+    CHECK(sendSocket(pair.first, "x", 1, 0) == 1);
+    char c;
+    CHECK(receiveSocket(pair.second, &c, 1, 0) == 1);
+    CHECK(c == 'x');
+
+    std::error_code ec;
+    auto bad = SocketPair::create(AF_INET, SOCK_STREAM, 0, ec);
+    CHECK(ec);
+    CHECK(!bad.first);
+    CHECK(!bad.second);
+}
+
+TEST_CASE("message channel") {
+    auto [parent, child] = MessageChannel::createPair(256 * 1024, 0);
+    REQUIRE(parent);
+    REQUIRE(child);
+    CHECK(getSocketOption(parent.socket(), SockOptSndBuf) >= 256 * 1024);
+    CHECK(getSocketOption(child.socket(), SockOptRcvBuf) >= 256 * 1024);
+
+    CHECK(parent.send("first", 5, 0) == 5);
+    CHECK(parent.send("second", 6, 0) == 6);
+    char buf[16];
+    CHECK(child.receive(buf, sizeof(buf), 0) == 5);
+    CHECK(memcmp(buf, "first", 5) == 0);
+    CHECK(child.receive(buf, sizeof(buf), 0) == 6);
+    CHECK(memcmp(buf, "second", 6) == 0);
+
+    auto pipe = Pipe::create();
+    int toSend[] = {pipe.writeEnd.get()};
+    CHECK(parent.send("fd", 2, toSend, 0) == 2);
+    FileDescriptor received[2];
+    auto res = child.receive(buf, sizeof(buf), received, 0);
+    CHECK(res.size == 2);
+    CHECK(res.descriptors == 1);
+    CHECK(!res.truncated);
+    CHECK(!res.descriptorsTruncated);
+    REQUIRE(received[0]);
+    CHECK(received[0].get() != pipe.writeEnd.get());
+    CHECK(writeFile(received[0], "ok", 2) == 2);
+    CHECK(readFile(pipe.readEnd, buf, 2) == 2);
+    CHECK(memcmp(buf, "ok", 2) == 0);
+
+    int twoFds[] = {pipe.readEnd.get(), pipe.writeEnd.get()};
+    CHECK(parent.send("overflow", 8, twoFds, 0) == 8);
+    FileDescriptor one[1];
+    res = child.receive(buf, 4, one, 0);
+    CHECK(res.descriptors == 1);
+    CHECK(res.descriptorsTruncated);
+    CHECK(res.truncated);
+    CHECK(bool(one[0]));
+
+    int tooMany[MessageChannel::maxDescriptors + 1] = {};
+    CHECK_THROWS_MATCHES(parent.send("x", 1, tooMany, 0), std::errc::invalid_argument);
+
+    SocketBatch out(4, 32);
+    for (size_t i = 0; i < 4; ++i) {
+        memset(out.buffer(i).data(), int('a' + i), i + 1);
+        out.setMessage(i, i + 1);
+    }
+    CHECK(parent.sendBatch(out, 4, 0) == 4);
+    SocketBatch in(8, 32);
+    size_t total = 0;
+    while (total < 4) {
+        auto count = child.receiveBatch(in, MSG_DONTWAIT);
+        REQUIRE(count > 0);
+        for (size_t i = 0; i < count; ++i, ++total) {
+            CHECK(in.length(i) == total + 1);
+            CHECK(char(in.data(i)[0]) == char('a' + total));
+        }
+    }
+
+    auto sock = child.detach();
+    CHECK(!child);
+    CHECK(sock);
+}
+
+TEST_CASE("batched send/recv") {
+    auto recvSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(0x7F000001);
+    ptl::socklen_t addrLen = sizeof(addr);
+    bindSocket(recvSock, reinterpret_cast<sockaddr *>(&addr), addrLen);
+    getSocketName(recvSock, reinterpret_cast<sockaddr *>(&addr), &addrLen);
+
+    auto sendSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+
+    SocketBatch sendBatch(4, 16);
+    for (size_t i = 0; i < 4; ++i) {
+        auto buf = sendBatch.buffer(i);
+        memset(buf.data(), int('a' + i), i + 1);
+        sendBatch.setMessage(i, i + 1, reinterpret_cast<sockaddr *>(&addr), addrLen);
+    }
+    CHECK(sendSocketBatch(sendSock, sendBatch, 4, 0) == 4);
+    CHECK(sendBatch.size() == 4);
+
+    SocketBatch recvBatch(8, 16);
+    size_t total = 0;
+    while (total < 4) {
+        auto count = receiveSocketBatch(recvSock, recvBatch, MsgWaitForOne);
+        REQUIRE(count > 0);
+        for (size_t i = 0; i < count; ++i, ++total) {
+            CHECK(recvBatch.length(i) == total + 1);
+            CHECK(recvBatch.data(i).size() == total + 1);
+            CHECK(char(recvBatch.data(i)[0]) == char('a' + total));
+            CHECK(recvBatch.addressLength(i) == sizeof(sockaddr_in));
+            CHECK(recvBatch.address(i)->sa_family == AF_INET);
+        }
+    }
+
+    std::error_code ec;
+    auto count = receiveSocketBatch(recvSock, recvBatch, 8, MSG_DONTWAIT, std::chrono::milliseconds(10), ec);
+    CHECK(count == 0);
+    CHECK(errorEquals(ec, std::errc::resource_unavailable_try_again));
+
+    //a moved-from batch no longer refers to the moved memory
+    SocketBatch moved(std::move(recvBatch));
+    CHECK(moved.capacity() == 8);
+    CHECK(recvBatch.capacity() == 0);
+    CHECK(recvBatch.headers() == nullptr);
+    CHECK(receiveSocketBatch(recvSock, recvBatch, MSG_DONTWAIT, ec) == 0);
+    recvBatch = std::move(moved);
+    CHECK(recvBatch.capacity() == 8);
+    CHECK(moved.capacity() == 0);
+    sendSocketBatch(sendSock, sendBatch, 1, 0);
+    CHECK(receiveSocketBatch(recvSock, recvBatch, MsgWaitForOne) == 1);
+    CHECK(recvBatch.length(0) == 1);
+}
+
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+TEST_CASE("UDP segmentation offload") {
+    auto recvSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(0x7F000001);
+    ptl::socklen_t addrLen = sizeof(addr);
+    bindSocket(recvSock, reinterpret_cast<sockaddr *>(&addr), addrLen);
+    getSocketName(recvSock, reinterpret_cast<sockaddr *>(&addr), &addrLen);
+
+    std::error_code ec;
+    setSocketOption(recvSock, SockOptUDPGro, true, ec);
+    if (ec) {
+        CHECK(errorEquals(ec, std::errc::no_protocol_option));
+        return;
+    }
+
+    //other control messages must not crowd out UDP_GRO
+    int yes = 1;
+    setSocketOption(recvSock, IPPROTO_IP, IP_PKTINFO, &yes, sizeof(yes));
+    #ifdef SO_TIMESTAMPNS
+        setSocketOption(recvSock, SockOptTimestampNs, true);
+    #endif
+
+    auto sendSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    setSocketOption(sendSock, SockOptUDPSegment, 0);
+    CHECK(getSocketOption(sendSock, SockOptUDPSegment) == 0);
+
+    char payload[10];
+    memcpy(payload, "aaaabbbbcc", 10);
+    auto sent = sendSocketSegmented(sendSock, payload, sizeof(payload), 4, 0, reinterpret_cast<sockaddr *>(&addr), addrLen, ec);
+    if (ec) {
+        //EINVAL from kernels that do not know UDP_SEGMENT, EIO when the route has no GSO support
+        CHECK((errorEquals(ec, std::errc::invalid_argument) || errorEquals(ec, std::errc::io_error)));
+        return;
+    }
+    CHECK(sent == 10);
+
+    //depending on the kernel datagrams arrive either coalesced or one by one
+    std::string received;
+    std::vector<size_t> sizes;
+    while (received.size() < 10) {
+        char buf[64];
+        auto segments = receiveSocketCoalesced(recvSock, buf, sizeof(buf), 0);
+        REQUIRE(!segments.empty());
+        CHECK(!segments.truncated());
+        CHECK(segments.length() == segments.data().size());
+        for (auto segment: segments) {
+            sizes.push_back(segment.size());
+            received.append(reinterpret_cast<const char *>(segment.data()), segment.size());
+        }
+    }
+    CHECK(received == "aaaabbbbcc");
+    CHECK(sizes == std::vector<size_t>{4, 4, 2});
+
+    sendSocket(sendSock, payload, sizeof(payload), 0, reinterpret_cast<sockaddr *>(&addr), addrLen);
+    char small[6];
+    auto segments = receiveSocketCoalesced(recvSock, small, sizeof(small), MSG_TRUNC);
+    CHECK(segments.truncated());
+    CHECK(segments.length() == sizeof(payload));
+    CHECK(segments.data().size() == sizeof(small));
+}
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+TEST_CASE("zero copy send") {
+    auto recvSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(0x7F000001);
+    ptl::socklen_t addrLen = sizeof(addr);
+    bindSocket(recvSock, reinterpret_cast<sockaddr *>(&addr), addrLen);
+    getSocketName(recvSock, reinterpret_cast<sockaddr *>(&addr), &addrLen);
+
+    auto sendSock = createSocket(PF_INET, SOCK_DGRAM, 0);
+    std::error_code ec;
+    setSocketOption(sendSock, SockOptZeroCopy, true, ec);
+    if (ec)
+        return;
+    CHECK(getSocketOption(sendSock, SockOptZeroCopy));
+
+    CHECK(!receiveZeroCopyCompletion(sendSock));
+
+    uint32_t sequence = 0;
+    static const char payload[] = "hello";
+    for (int i = 0; i < 3; ++i) {
+        auto sent = sendSocketZeroCopy(sendSock, payload, 5, 0, sequence, reinterpret_cast<sockaddr *>(&addr), addrLen, ec);
+        if (ec) //UDP zerocopy needs Linux 5.0
+            return;
+        CHECK(sent == 5);
+    }
+    CHECK(sequence == 3);
+
+    char buf[5];
+    for (int i = 0; i < 3; ++i)
+        CHECK(receiveSocket(recvSock, buf, sizeof(buf), 0) == 5);
+
+    uint32_t completed = 0;
+    while (completed < sequence) {
+        pollfd pfd{sendSock.get(), 0, 0};
+        REQUIRE(::poll(&pfd, 1, 5000) == 1);
+        while (auto completion = receiveZeroCopyCompletion(sendSock)) {
+            CHECK(completion->first == completed);
+            CHECK(completion->contains(completed));
+            CHECK(!completion->contains(completion->last + 1));
+            completed += completion->count();
+        }
+    }
+    CHECK(completed == 3);
+}
+
+#if defined(SO_TIMESTAMPING) && defined(SO_EE_ORIGIN_TIMESTAMPING) && __has_include(<linux/net_tstamp.h>)
+TEST_CASE("zero copy send with tx timestamps") {
+    auto receiver = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto address = getSocketName(receiver);
+
+    auto sender = createSocket(PF_INET, SOCK_DGRAM, 0);
+    std::error_code ec;
+    setSocketOption(sender, SockOptZeroCopy, true, ec);
+    if (ec)
+        return;
+    setSocketOption(sender, SockOptTimestamping, TimestampingFlags::TxSoftware | TimestampingFlags::Software | 
+                                                 TimestampingFlags::OptId | TimestampingFlags::OptTsOnly);
+
+    uint32_t sequence = 0;
+    for (int i = 0; i < 3; ++i) {
+        auto sent = sendSocketZeroCopy(sender, "hello", 5, 0, sequence, address.data(), address.length(), ec);
+        if (errorEquals(ec, std::errc::no_buffer_space))
+            return;
+        CHECK(sent == 5);
+    }
+    char buf[5];
+    for (int i = 0; i < 3; ++i)
+        CHECK(receiveSocket(receiver, buf, sizeof(buf), 0) == 5);
+
+    //the timestamps queued in between are skipped, not reported as errors
+    uint32_t completed = 0;
+    while (completed < sequence) {
+        pollfd pfd{c_socket(sender), 0, 0};
+        REQUIRE(::poll(&pfd, 1, 5000) == 1);
+        while (auto completion = receiveZeroCopyCompletion(sender, ec)) {
+            CHECK(completion->first == completed);
+            completed += completion->count();
+        }
+        REQUIRE(!ec);
+    }
+    CHECK(completed == 3);
+    CHECK(!receiveTxTimestamp(sender));
+}
+#endif
+#endif
+
+TEST_CASE("connection lifecycle") {
+    auto listener = createSocket(PF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bindSocket(listener, (const sockaddr *)&addr, sizeof(addr));
+    socklen_t addrLen = sizeof(addr);
+    getSocketName(listener, (sockaddr *)&addr, &addrLen);
+    listenSocket(listener, 8);
+
+    auto client = createSocket(PF_INET, SOCK_STREAM, 0);
+    connectSocket(client, (const sockaddr *)&addr, sizeof(addr), std::chrono::milliseconds(1000));
+    //the original blocking mode must be restored
+    CHECK((::fcntl(c_socket(client), F_GETFL) & O_NONBLOCK) == 0);
+
+    sockaddr_in peer = {};
+    socklen_t peerLen = sizeof(peer);
+    #if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+        const int flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    #else
+        const int flags = 0;
+    #endif
+    auto server = acceptSocket(listener, (sockaddr *)&peer, &peerLen, flags);
+    REQUIRE(server);
+    CHECK(peer.sin_family == AF_INET);
+    #if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+        CHECK((::fcntl(c_socket(server), F_GETFL) & O_NONBLOCK) != 0);
+        CHECK((::fcntl(c_socket(server), F_GETFD) & FD_CLOEXEC) != 0);
+    #endif
+
+    writeFile(client, "hello", 5);
+    shutdownSocket(client, SHUT_WR);
+    pollfd pfd{c_socket(server), POLLIN, 0};
+    REQUIRE(::poll(&pfd, 1, 1000) == 1);
+    char buf[16];
+    CHECK(receiveSocket(server, buf, sizeof(buf), 0) == 5);
+    REQUIRE(::poll(&pfd, 1, 1000) == 1);
+    CHECK(receiveSocket(server, buf, sizeof(buf), 0) == 0);
+
+    ::fcntl(c_socket(listener), F_SETFL, ::fcntl(c_socket(listener), F_GETFL) | O_NONBLOCK);
+    auto client1 = createSocket(PF_INET, SOCK_STREAM, 0);
+    auto client2 = createSocket(PF_INET, SOCK_STREAM, 0);
+    connectSocket(client1, (const sockaddr *)&addr, sizeof(addr));
+    connectSocket(client2, (const sockaddr *)&addr, sizeof(addr));
+    pfd = {c_socket(listener), POLLIN, 0};
+    REQUIRE(::poll(&pfd, 1, 1000) == 1);
+    Socket accepted[4];
+    size_t total = 0;
+    for (int i = 0; i < 10 && total < 2; ++i) {
+        total += acceptSocketBatch(listener, std::span(accepted).subspan(total), flags);
+        if (total < 2)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(total == 2);
+    CHECK(accepted[0]);
+    CHECK(accepted[1]);
+    CHECK(!accepted[2]);
+
+    std::error_code ec;
+    auto none = acceptSocket(listener, flags, ec);
+    CHECK(!none);
+    CHECK((errorEquals(ec, std::errc::resource_unavailable_try_again) || errorEquals(ec, std::errc::operation_would_block)));
+}
+
+#ifdef MSG_DONTWAIT
+TEST_CASE("spinning receive") {
+    auto receiver = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto address = getSocketName(receiver);
+    auto sender = createSocket(PF_INET, SOCK_DGRAM, 0);
+
+    #ifdef SO_BUSY_POLL
+    {
+        //raising busy poll values requires CAP_NET_ADMIN
+        std::error_code ec;
+        setSocketOption(receiver, SockOptBusyPoll, 50, ec);
+        if (!ec)
+            CHECK(getSocketOption(receiver, SockOptBusyPoll) == 50);
+        else
+            CHECK(errorEquals(ec, std::errc::operation_not_permitted));
+    }
+    #endif
+
+    SpinReceiveStats stats;
+    char buf[16];
+    CHECK(sendSocket(sender, "hello", 5, 0, address) == 5);
+    CHECK(receiveSocketSpinning(receiver, buf, sizeof(buf), 0, std::chrono::milliseconds(100), stats) == 5);
+    CHECK(stats.spinHits == 1);
+    CHECK(stats.blockingWaits == 0);
+
+    std::thread delayed([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        sendSocket(sender, "world", 5, 0, address);
+    });
+    CHECK(receiveSocketSpinning(receiver, buf, sizeof(buf), 0, std::chrono::microseconds(100), stats) == 5);
+    delayed.join();
+    CHECK(memcmp(buf, "world", 5) == 0);
+    CHECK(stats.spinHits == 1);
+    CHECK(stats.blockingWaits == 1);
+    CHECK(stats.spinIterations > 0);
+}
+#endif
+
+TEST_CASE("packet timestamps") {
+    auto receiver = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto address = getSocketName(receiver);
+    auto sender = createSocket(PF_INET, SOCK_DGRAM, 0);
+    char buf[16];
+    PacketTimestamps timestamps;
+
+    #ifdef SO_TIMESTAMPNS
+    {
+        setSocketOption(receiver, SockOptTimestampNs, true);
+        auto before = std::chrono::system_clock::now();
+        sendSocket(sender, "hello", 5, 0, address);
+        CHECK(receiveSocketTimestamped(receiver, buf, sizeof(buf), 0, timestamps) == 5);
+        REQUIRE(timestamps.software);
+        CHECK(*timestamps.software >= before - std::chrono::seconds(1));
+        CHECK(*timestamps.software <= std::chrono::system_clock::now());
+        CHECK(!timestamps.hardware);
+        setSocketOption(receiver, SockOptTimestampNs, false);
+    }
+    #endif
+
+    #if defined(SO_TIMESTAMPING) && defined(SO_EE_ORIGIN_TIMESTAMPING) && __has_include(<linux/net_tstamp.h>)
+    {
+        setSocketOption(receiver, SockOptTimestamping, TimestampingFlags::RxSoftware | TimestampingFlags::Software);
+        CHECK(getSocketOption(receiver, SockOptTimestamping) == (TimestampingFlags::RxSoftware | TimestampingFlags::Software));
+
+        //the kernel turns on RX software stamping asynchronously so the first packets may arrive unstamped
+        for (auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5); ; ) {
+            sendSocket(sender, "probe", 5, 0, address);
+            REQUIRE(receiveSocketTimestamped(receiver, buf, sizeof(buf), 0, timestamps) == 5);
+            if (timestamps.software)
+                break;
+            REQUIRE(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        setSocketOption(sender, SockOptTimestamping, TimestampingFlags::TxSoftware | TimestampingFlags::Software | 
+                                                     TimestampingFlags::OptId | TimestampingFlags::OptTsOnly);
+
+        CHECK(!receiveTxTimestamp(sender));
+
+        auto before = std::chrono::system_clock::now();
+        sendSocket(sender, "hello", 5, 0, address);
+        sendSocket(sender, "world", 5, 0, address);
+        CHECK(receiveSocketTimestamped(receiver, buf, sizeof(buf), 0, timestamps) == 5);
+        REQUIRE(timestamps.software);
+        CHECK(*timestamps.software >= before - std::chrono::seconds(1));
+
+        for (uint32_t id = 0; id < 2; ++id) {
+            pollfd pfd{c_socket(sender), 0, 0};
+            REQUIRE(::poll(&pfd, 1, 1000) == 1);
+            auto tx = receiveTxTimestamp(sender);
+            REQUIRE(tx);
+            CHECK(tx->type == TxTimestampType::Sent);
+            CHECK(tx->id == id);
+            REQUIRE(tx->timestamps.software);
+            CHECK(*tx->timestamps.software >= before - std::chrono::seconds(1));
+        }
+        CHECK(!receiveTxTimestamp(sender));
+    }
+    #endif
+}
+
+#if defined(SO_TIMESTAMPING) && defined(SO_EE_ORIGIN_TIMESTAMPING) && __has_include(<linux/net_tstamp.h>) && \
+    defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+TEST_CASE("error queue notifications") {
+    auto receiver = createSocket(PF_INET, SOCK_DGRAM, 0);
+    bindSocket(receiver, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    auto address = getSocketName(receiver);
+
+    auto sender = createSocket(PF_INET, SOCK_DGRAM, 0);
+    std::error_code ec;
+    setSocketOption(sender, SockOptZeroCopy, true, ec);
+    if (ec)
+        return;
+    setSocketOption(sender, SockOptTimestamping, TimestampingFlags::TxSoftware | TimestampingFlags::Software | 
+                                                 TimestampingFlags::OptId | TimestampingFlags::OptTsOnly);
+    CHECK(!receiveErrorQueueNotification(sender));
+
+    uint32_t sequence = 0;
+    for (int i = 0; i < 2; ++i) {
+        sendSocketZeroCopy(sender, "hello", 5, 0, sequence, address.data(), address.length(), ec);
+        if (errorEquals(ec, std::errc::no_buffer_space))
+            return;
+        REQUIRE(!ec);
+    }
+
+    uint32_t completed = 0;
+    std::vector<uint32_t> stamped;
+    while (completed < 2 || stamped.size() < 2) {
+        pollfd pfd{c_socket(sender), 0, 0};
+        REQUIRE(::poll(&pfd, 1, 5000) == 1);
+        while (auto notification = receiveErrorQueueNotification(sender)) {
+            if (auto completion = std::get_if<ZeroCopyCompletion>(&*notification)) {
+                CHECK(completion->first == completed);
+                completed += completion->count();
+            } else {
+                auto & tx = std::get<TxTimestamp>(*notification);
+                CHECK(tx.type == TxTimestampType::Sent);
+                CHECK(tx.timestamps.software);
+                stamped.push_back(tx.id);
+            }
+        }
+    }
+    CHECK(completed == 2);
+    CHECK(stamped == std::vector<uint32_t>{0, 1});
+}
+#endif
+
+#ifdef SO_REUSEPORT
+TEST_CASE("SO_REUSEPORT group") {
+    std::vector<ReusePortSteering> steerings{ReusePortSteering::None};
+    #ifdef SO_INCOMING_CPU
+        steerings.push_back(ReusePortSteering::IncomingCPU);
+    #endif
+    #if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+        steerings.push_back(ReusePortSteering::CPUFilter);
+    #endif
+    for (auto steering: steerings) {
+        auto group = ReusePortGroup::create(SocketAddress::ipv4(INADDR_LOOPBACK, 0), 3, 8, steering);
+        REQUIRE(group.size() == 3);
+        CHECK(group.address().port() != 0);
+        for (auto & listener: group.listeners())
+            CHECK(getSocketName(listener) == group.address());
+
+        auto client = createSocket(PF_INET, SOCK_STREAM, 0);
+        connectSocket(client, group.address());
+
+        std::vector<pollfd> pfds;
+        for (auto & listener: group.listeners())
+            pfds.push_back({c_socket(listener), POLLIN, 0});
+        REQUIRE(::poll(pfds.data(), pfds.size(), 1000) == 1);
+        for (size_t i = 0; i < pfds.size(); ++i) {
+            if (!(pfds[i].revents & POLLIN))
+                continue;
+            auto conn = acceptSocket(group[i], 0);
+            CHECK(conn);
+            #ifdef SO_INCOMING_CPU
+                CHECK(getSocketOption(conn, SockOptIncomingCPU) >= 0);
+            #endif
+        }
+    }
+}
+
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+TEST_CASE("SO_REUSEPORT CPU steering") {
+    cpu_set_t allowed;
+    REQUIRE(::sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    std::vector<size_t> cpus;
+    for (size_t cpu = 0; cpu < CPU_SETSIZE && cpus.size() < 3; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed))
+            cpus.push_back(cpu);
+    }
+    if (cpus.size() < 2) {
+        MESSAGE("skipped: CPU steering needs at least 2 usable CPUs");
+        return;
+    }
+
+    const size_t count = 3;
+    auto group = ReusePortGroup::create(SocketAddress::ipv4(INADDR_LOOPBACK, 0), count, 8, ReusePortSteering::CPUFilter);
+    for (size_t cpu: cpus) {
+        //loopback processes the SYN on the sending CPU, which is what the filter sees
+        auto client = createSocket(PF_INET, SOCK_STREAM, 0);
+        std::thread([&]() {
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            REQUIRE(::sched_setaffinity(0, sizeof(pinned), &pinned) == 0);
+            connectSocket(client, group.address());
+        }).join();
+
+        std::vector<pollfd> pfds;
+        for (auto & listener: group.listeners())
+            pfds.push_back({c_socket(listener), POLLIN, 0});
+        REQUIRE(::poll(pfds.data(), pfds.size(), 1000) == 1);
+        const size_t expected = cpu % count;
+        CHECK(pfds[expected].revents & POLLIN);
+        if (pfds[expected].revents & POLLIN)
+            CHECK(acceptSocket(group[expected], 0));
+    }
+}
+#endif
+#endif
+
+#if defined(__linux__) && defined(TCP_INFO)
+TEST_CASE("TCP info") {
+    auto listener = createSocket(PF_INET, SOCK_STREAM, 0);
+    bindSocket(listener, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+    listenSocket(listener, 1);
+    auto client = createSocket(PF_INET, SOCK_STREAM, 0);
+    connectSocket(client, getSocketName(listener));
+    auto server = acceptSocket(listener, 0);
+
+    ::tcp_info raw = getSocketOption(client, SockOptTCPInfo);
+    CHECK(raw.tcpi_state == TCP_ESTABLISHED);
+
+    //a structure declared bigger than the kernel's is read partially and zero filled
+    struct FutureTcpInfo {
+        ::tcp_info info;
+        uint8_t future[1024];
+    };
+    constexpr auto SockOptFutureTCPInfo = SockOptExtensibleDesc<FutureTcpInfo>{IPPROTO_TCP, TCP_INFO};
+    FutureTcpInfo future;
+    memset(&future, 0xFF, sizeof(future));
+    getSocketOption(client, SockOptFutureTCPInfo, future);
+    CHECK(future.info.tcpi_state == TCP_ESTABLISHED);
+    CHECK(future.future[sizeof(future.future) - 1] == 0);
+
+    TcpInfoSampler sampler(std::chrono::hours(1));
+    sampler.add(client);
+    sampler.add(client);
+    CHECK(sampler.size() == 1);
+    CHECK(sampler.poll([](int, const TcpInfo &, const TcpInfoDelta &) { FAIL("no previous sample"); }) == 0);
+
+    char buf[1000] = {};
+    writeFile(client, buf, sizeof(buf));
+    CHECK(readFile(server, buf, sizeof(buf)) > 0);
+
+    auto info = getTcpInfo(client);
+    CHECK(info.state == TCP_ESTABLISHED);
+    CHECK(info.mss > 0);
+    CHECK(info.congestionWindow > 0);
+    
+    //the interval has not elapsed
+    CHECK(sampler.poll([](int, const TcpInfo &, const TcpInfoDelta &) {}) == 0);
+    uint64_t sent = 0;
+    CHECK(sampler.sample([&](int fd, const TcpInfo & current, const TcpInfoDelta & delta) {
+        CHECK(fd == c_socket(client));
+        CHECK(current.state == TCP_ESTABLISHED);
+        CHECK(delta.interval.count() > 0);
+        sent = delta.segmentsOut;
+    }) == 1);
+    CHECK(sent > 0);
+
+    sampler.remove(client);
+    CHECK(sampler.size() == 0);
+
+    //an injected clock is used for the sample times too
+    auto start = std::chrono::steady_clock::now();
+    TcpInfoSampler clocked(std::chrono::seconds(1));
+    clocked.add(client);
+    CHECK(clocked.poll([](int, const TcpInfo &, const TcpInfoDelta &) {}, start) == 0);
+    CHECK(clocked.nextSampleTime() == start + std::chrono::seconds(1));
+    CHECK(clocked.poll([&](int, const TcpInfo & current, const TcpInfoDelta & delta) {
+        CHECK(current.time == start + std::chrono::seconds(3));
+        CHECK(delta.interval == std::chrono::seconds(3));
+    }, start + std::chrono::seconds(3)) == 1);
+
+    //32-bit kernel counters wrap
+    TcpInfo before{}, after{};
+    before.segmentsOut = 0xFFFF'FFF0;
+    after.segmentsOut = 0x10;
+    before.bytesSent = 100;
+    after.bytesSent = 300;
+    auto delta = TcpInfoDelta::between(before, after);
+    CHECK(delta.segmentsOut == 0x20);
+    CHECK(delta.bytesSent == 200);
+}
+#endif
+
 #endif
 
 }
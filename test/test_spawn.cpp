@@ -189,6 +189,201 @@ TEST_CASE("c_pid") {
     proc.wait();
 }
 
+TEST_CASE("spawn template") {
+    SpawnTemplate tmpl("sh", std::vector<std::string>{"PTL_A=1", "PTL_B=2"});
+    tmpl.usePath();
+    auto [read, write] = Pipe::create();
+    tmpl.fileActions().addDuplicateTo(write, stdout);
+    CHECK(std::string_view(tmpl.environment()[1]) == "PTL_B=2");
+    CHECK(tmpl.environment()[2] == nullptr);
+
+    {
+        auto proc = tmpl.spawn({"sh", "-c", "echo $PTL_A$PTL_B"});
+        auto overridden = tmpl.spawn({"sh", "-c", "echo $PTL_A$PTL_B$PTL_C"}, {"PTL_B=x", "PTL_C=y"});
+        write.close();
+        CHECK(WEXITSTATUS(proc.wait().value()) == 0);
+        CHECK(WEXITSTATUS(overridden.wait().value()) == 0);
+    }
+    std::string res(64, '\0');
+    size_t total = 0;
+    while (auto count = readFile(read, res.data() + total, res.size() - total))
+        total += size_t(count);
+    res.resize(total);
+    CHECK((res == "12\n1xy\n" || res == "1xy\n12\n"));
+
+    SpawnTemplate inherited("/bin/sh");
+    bool hasPath = false;
+    for (auto env = inherited.environment(); *env; ++env)
+        hasPath = hasPath || std::string_view(*env).starts_with("PATH=");
+    CHECK(hasPath == (getenv("PATH") != nullptr));
+
+    SpawnTemplate overriding("sh", std::vector<std::string>{"PTL_A=1", "PTL_B=2", "PTL_BB=3"});
+    overriding.usePath();
+    auto unset = overriding.spawn({"sh", "-c", R"(test "$PTL_A" = 1 && test -z "${PTL_B+set}" && test "$PTL_BB" = 3)"}, {"PTL_B"});
+    CHECK(WEXITSTATUS(unset.wait().value()) == 0);
+    auto prefixed = overriding.spawn({"sh", "-c", R"(test "$PTL_B" = 2 && test "$PTL_BB" = x)"}, {"PTL_BB=x"});
+    CHECK(WEXITSTATUS(prefixed.wait().value()) == 0);
+    CHECK_THROWS_MATCHES(overriding.spawn({"sh", "-c", "true"}, {"=x"}), std::errc::invalid_argument);
+}
+
+TEST_CASE("spawn batch") {
+    SpawnTemplate tmpl("/bin/sh");
+
+    std::vector<std::vector<std::string>> args;
+    std::vector<std::vector<std::string>> envs;
+    for (int i = 0; i < 40; ++i) {
+        args.push_back({"sh", "-c", "exit $PTL_CODE"});
+        envs.push_back({"PTL_CODE=" + std::to_string(i % 7)});
+    }
+    auto batch = tmpl.spawnBatch(args, envs, 4);
+    REQUIRE(batch.children.size() == 40);
+    CHECK(batch.statistics.count == 40);
+    CHECK(batch.statistics.min <= batch.statistics.median);
+    CHECK(batch.statistics.median <= batch.statistics.p99);
+    CHECK(batch.statistics.p99 <= batch.statistics.max);
+    CHECK(batch.statistics.min.count() > 0);
+    CHECK(batch.statistics.elapsed >= batch.statistics.max);
+    for (size_t i = 0; i < batch.children.size(); ++i) {
+        CHECK(batch.errors[i] == 0);
+        auto stat = batch.children[i].wait().value();
+        CHECK(WEXITSTATUS(stat) == int(i % 7));
+    }
+
+    SpawnTemplate missing("/no/such/exe");
+    std::array<std::array<const char *, 2>, 3> missingArgs = {{{"x", nullptr}, {"y", nullptr}, {"z", nullptr}}};
+    auto failed = missing.spawnBatch(missingArgs, 2);
+    #if !defined(__ANDROID__) && !defined(__OpenBSD__)
+    if (getenv("QEMU_LD_PREFIX") == nullptr) {
+        CHECK(failed.statistics.count == 0);
+        for (size_t i = 0; i < 3; ++i) {
+            CHECK(!failed.children[i]);
+            CHECK(failed.errors[i] == ENOENT);
+        }
+    }
+    #endif
+
+    CHECK_THROWS_MATCHES(tmpl.spawnBatch(args, std::vector<std::vector<std::string>>{}), std::errc::invalid_argument);
+}
+
+#if PTL_HAVE_PIDFD
+
+TEST_CASE("pidfd") {
+    auto proc = spawn({"sleep", "30"}, SpawnSettings().usePath().openPidfd());
+    REQUIRE(proc);
+    REQUIRE(proc.pidfd());
+
+    CHECK(!proc.wait(std::chrono::milliseconds(20)).has_value());
+    CHECK(proc);
+    pollfd pfd{proc.pidfd().get(), POLLIN, 0};
+    CHECK(poll(&pfd, 1, 0) == 0);
+
+    sendSignal(proc, SIGTERM);
+    CHECK(poll(&pfd, 1, 5000) == 1);
+    auto stat = proc.wait(std::chrono::seconds(5));
+    REQUIRE(stat);
+    CHECK(WIFSIGNALED(*stat));
+    CHECK(WTERMSIG(*stat) == SIGTERM);
+    CHECK(!proc);
+    CHECK(!proc.pidfd());
+
+    //opened on demand, including for a child that already exited
+    auto exited = spawn({"/bin/sh", "-c", "exit 4"});
+    CHECK(!exited.pidfd());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stat = exited.wait(std::chrono::seconds(5));
+    REQUIRE(stat);
+    CHECK(WIFEXITED(*stat));
+    CHECK(WEXITSTATUS(*stat) == 4);
+
+    auto self = openPidfd(getpid(), 0);
+    CHECK(self);
+    sendPidfdSignal(self, 0);
+
+    std::error_code ec;
+    openPidfd(pid_t(999999999), 0, ec);
+    CHECK(errorEquals(ec, std::errc::invalid_argument) || errorEquals(ec, std::errc::no_such_process));
+    ChildProcess empty;
+    CHECK_THROWS_MATCHES(empty.openPidfd(), std::errc::invalid_argument);
+}
+
+#endif
+
+#if PTL_HAVE_VFORK && !defined(__APPLE__)
+
+TEST_CASE("vfork spawn backend") {
+    auto readAll = [](FileDescriptor & fd) {
+        std::string res(256, '\0');
+        size_t total = 0;
+        while (auto count = readFile(fd, res.data() + total, res.size() - total))
+            total += size_t(count);
+        res.resize(total);
+        return res;
+    };
+
+    {
+        auto [read, write] = Pipe::create();
+        SpawnFileActions act;
+        act.addDuplicateTo(write, stdout);
+        act.addOpen(stdin, "/dev/null", O_RDONLY, 0);
+        #if PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+        act.addChdirNp("/");
+        #endif
+        SpawnAttr attr;
+        attr.setFlags(POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+        auto proc = spawn({"sh", "-c", "echo $PTL_STRING; pwd; test \"$(ps -o pgid= $$ | tr -d ' ')\" = $$ && echo leader"}, 
+                          {"PTL_STRING=haha", "PATH=/bin:/usr/bin"},
+                          SpawnSettings().fileActions(act).attr(attr).usePath().backend(SpawnBackend::Vfork));
+        write.close();
+        auto res = readAll(read);
+        auto stat = proc.wait().value();
+        CHECK(WIFEXITED(stat));
+        CHECK(WEXITSTATUS(stat) == 0);
+        CHECK(res.starts_with("haha\n"));
+        #if PTL_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+        CHECK(res.find("\n/\n") != res.npos);
+        #endif
+        if (system("command -v ps >/dev/null 2>&1") == 0)
+            CHECK(res.ends_with("leader\n"));
+    }
+
+    auto settings = SpawnSettings().backend(SpawnBackend::Vfork);
+    std::error_code ec;
+    auto missing = spawn({"/no/such/exe"}, settings, ec);
+    CHECK(!missing);
+    CHECK(errorEquals(ec, std::errc::no_such_file_or_directory));
+    auto notFound = spawn({"no_such_exe_in_path"}, SpawnSettings(settings).usePath(), ec);
+    CHECK(!notFound);
+    CHECK(errorEquals(ec, std::errc::no_such_file_or_directory));
+
+    SpawnFileActions badAction;
+    badAction.addOpen(stdin, "/no/such/file", O_RDONLY, 0);
+    auto failedAction = spawn({"/bin/sh", "-c", "true"}, SpawnSettings(settings).fileActions(badAction), ec);
+    CHECK(!failedAction);
+    CHECK(errorEquals(ec, std::errc::no_such_file_or_directory));
+
+    //the parent mask is restored after the child execs
+    sigset_t before, after;
+    pthread_sigmask(SIG_SETMASK, nullptr, &before);
+    auto proc = spawn({"/bin/sh", "-c", "exit 3"}, settings);
+    pthread_sigmask(SIG_SETMASK, nullptr, &after);
+    CHECK(WEXITSTATUS(proc.wait().value()) == 3);
+    CHECK(sigismember(&after, SIGUSR1) == sigismember(&before, SIGUSR1));
+    CHECK(sigismember(&after, SIGTERM) == sigismember(&before, SIGTERM));
+
+    SpawnTemplate tmpl("/bin/sh");
+    tmpl.backend(SpawnBackend::Vfork);
+    auto batch = tmpl.spawnBatch(std::vector<std::vector<std::string>>(8, {"sh", "-c", "exit 5"}), 2);
+    for (auto & child: batch.children)
+        CHECK(WEXITSTATUS(child.wait().value()) == 5);
+
+    posix_spawn_file_actions_t raw;
+    posix_spawn_file_actions_init(&raw);
+    CHECK_THROWS_MATCHES(spawn({"/bin/sh"}, SpawnSettings(settings).fileActions(&raw)), std::errc::invalid_argument);
+    posix_spawn_file_actions_destroy(&raw);
+}
+
+#endif
+
 #endif //ANDROID version check
 
 
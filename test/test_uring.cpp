@@ -0,0 +1,156 @@
+// Copyright (c) 2023, Eugene Gershnik
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <ptl/uring.h>
+
+#include "common.h"
+
+#include <string.h>
+
+using namespace ptl;
+
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+
+namespace {
+
+    auto waitForCompletions(IoUring & ring, size_t count) -> std::vector<UringCompletion> {
+        std::vector<UringCompletion> ret;
+        while (ret.size() < count) {
+            ring.submit(1);
+            ring.processCompletions([&](const UringCompletion & completion) {
+                ret.push_back(completion);
+            });
+        }
+        return ret;
+    }
+
+    auto createListener() -> Socket {
+        auto listener = createSocket(AF_INET, SOCK_STREAM, 0);
+        bindSocket(listener, SocketAddress::ipv4(INADDR_LOOPBACK, 0));
+        listenSocket(listener, 8);
+        return listener;
+    }
+
+    auto connectTo(const Socket & listener) -> Socket {
+        auto client = createSocket(AF_INET, SOCK_STREAM, 0);
+        connectSocket(client, getSocketName(listener));
+        return client;
+    }
+}
+
+TEST_SUITE("uring") {
+
+TEST_CASE("uring multishot accept") {
+    auto ring = IoUring::create(16);
+    REQUIRE(ring);
+    auto listener = createListener();
+
+    queueMultishotAccept(ring, listener, SOCK_CLOEXEC, 1);
+    CHECK(ring.submit(0) == 1);
+
+    auto client1 = connectTo(listener);
+    auto client2 = connectTo(listener);
+    auto completions = waitForCompletions(ring, 2);
+    for (auto & completion: completions) {
+        CHECK(completion.userData == 1);
+        CHECK(completion.more());
+        CHECK(!completion.bufferId());
+        auto accepted = acceptedSocket(completion);
+        REQUIRE(accepted);
+        CHECK(getSocketName(accepted) == getSocketName(listener));
+    }
+
+    std::error_code ec;
+    auto bad = acceptedSocket(UringCompletion{1, -EMFILE, 0}, ec);
+    CHECK(!bad);
+    CHECK(errorEquals(ec, std::errc::too_many_files_open));
+
+    queueCancel(ring, 1, 2);
+    completions = waitForCompletions(ring, 2);
+    for (auto & completion: completions) {
+        CHECK(!completion.more());
+        if (completion.userData == 1)
+            CHECK(completion.error() == ECANCELED);
+        else
+            CHECK(completion.result == 0);
+    }
+}
+
+TEST_CASE("uring multishot receive") {
+    auto ring = IoUring::create(16);
+    auto buffers = ProvidedBufferRing::create(ring, 7, 4, 64);
+    CHECK(buffers.groupId() == 7);
+    CHECK(buffers.count() == 4);
+    CHECK(buffers.bufferSize() == 64);
+
+    auto listener = createListener();
+    auto client1 = connectTo(listener);
+    auto client2 = connectTo(listener);
+    Socket server[] = {acceptSocket(listener, SOCK_CLOEXEC), acceptSocket(listener, SOCK_CLOEXEC)};
+
+    //both connections draw from the same buffers
+    queueMultishotReceive(ring, server[0], buffers, 0, 10);
+    queueMultishotReceive(ring, server[1], buffers, 0, 11);
+    ring.submit(0);
+
+    for (int round = 0; round < 5; ++round) {
+        sendSocket(client1, "hello", 5, 0);
+        sendSocket(client2, "world", 5, 0);
+        auto completions = waitForCompletions(ring, 2);
+        for (auto & completion: completions) {
+            CHECK(completion.more());
+            auto received = receivedBuffer(completion, buffers);
+            REQUIRE(received);
+            std::string_view text(reinterpret_cast<const char *>(received.data().data()), received.data().size());
+            CHECK(text == (completion.userData == 10 ? "hello" : "world"));
+        }
+    }
+
+    client1.close();
+    auto completions = waitForCompletions(ring, 1);
+    CHECK(completions[0].userData == 10);
+    CHECK(!completions[0].more());
+    Error err;
+    auto eof = receivedBuffer(completions[0], buffers, err);
+    CHECK(!err);
+    CHECK(eof.data().empty());
+
+    queueCancel(ring, 11, 12);
+    waitForCompletions(ring, 2);
+}
+
+TEST_CASE("uring buffer exhaustion") {
+    auto ring = IoUring::create(8);
+    auto buffers = ProvidedBufferRing::create(ring, 1, 1, 16);
+    auto [a, b] = SocketPair::create(AF_UNIX, SOCK_STREAM, 0);
+
+    queueMultishotReceive(ring, b, buffers, 0, 1);
+    ring.submit(0);
+
+    sendSocket(a, "x", 1, 0);
+    auto completions = waitForCompletions(ring, 1);
+    auto held = receivedBuffer(completions[0], buffers);
+    CHECK(held.data().size() == 1);
+
+    sendSocket(a, "y", 1, 0);
+    completions = waitForCompletions(ring, 1);
+    CHECK(!completions[0].more());
+    std::error_code ec;
+    receivedBuffer(completions[0], buffers, ec);
+    CHECK(errorEquals(ec, std::errc::no_buffer_space));
+
+    //once a buffer is back the receive can be queued again and picks up pending data
+    held.reset();
+    queueMultishotReceive(ring, b, buffers, 0, 2);
+    completions = waitForCompletions(ring, 1);
+    auto received = receivedBuffer(completions[0], buffers);
+    REQUIRE(received.data().size() == 1);
+    CHECK(char(received.data()[0]) == 'y');
+
+    CHECK_THROWS_MATCHES(ProvidedBufferRing::create(ring, 2, 3, 16), std::errc::invalid_argument);
+    CHECK_THROWS_MATCHES(ProvidedBufferRing::create(ring, 1, 1, 16), std::errc::file_exists);
+}
+
+}
+
+#endif